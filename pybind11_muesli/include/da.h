@@ -1,12 +1,28 @@
 #pragma once
 
+#include <memory>
+#include <string>
 #include <type_traits>
 #include "muesli.h"
 #include "detail/exception.h"
+#include "detail/exchange.h"
+#include "detail/ingest.h"
+#include "detail/batch.h"
+#include "detail/cfunction.h"
+#include "detail/mapping.h"
+#include "detail/partition.h"
+#include "detail/pipeline.h"
+#include "detail/pool.h"
+#include "detail/rma.h"
+#include "detail/types.h"
+#include "detail/unique.h"
+#include "operators.h"
+#include "expression.h"
+#include "jit.h"
+#include "threadpool.h"
 #include <pybind11/pybind11.h>
 #include <pybind11/functional.h>
 #include <pybind11/numpy.h>
-#include <openacc.h>
 
 namespace py = pybind11;
 
@@ -41,7 +57,7 @@ namespace msl {
         * @param size Size of the distributed array.
         * @param d Distribution of the distributed array.
         */
-        DA(int n);
+        DA(long n);
 
         /**
         * \brief Creates a distributed matrix with \em size elements equal to
@@ -50,13 +66,51 @@ namespace msl {
         * @param size Size of the distributed array.
         * @param initial_value Initial value for all elements.
         */
-        DA(int n, const T& initial_value);
+        DA(long n, const T& initial_value);
+
+        /**
+        * \brief Creates a distributed array whose local partitions are memory-mapped
+        *        from files, so that it may be larger than the main memory. Each
+        *        process maps the slice of \em path holding its local partition or, if
+        *        \em perRank is true, the whole file \em path.<rank>. Files are created
+        *        or extended as needed; the elements they already contain are kept.
+        *        Maps in place and mapTo() write through to the files, whereas copies
+        *        and the results of other skeletons reside in main memory.
+        *
+        * @param n Size of the distributed array.
+        * @param path Path of the file.
+        * @param perRank Whether each process maps a file of its own.
+        */
+        DA(long n, const std::string& path, bool perRank = false);
 
         /**
         * \brief Destructor.
         */
         ~DA();
 
+        /**
+        * \brief Copy constructor. The copy shares the local partition with \em other
+        *        until either of them is modified. NumPy views of \em other do not
+        *        carry over, so they never see writes to the copy.
+        */
+        DA(const DA<T>& other);
+
+        /**
+        * \brief Move constructor. Takes over the local partition of \em other,
+        *        which is left empty (without elements).
+        */
+        DA(DA<T>&& other);
+
+        /**
+        * \brief Copy assignment. See the copy constructor.
+        */
+        DA<T>& operator=(const DA<T>& other);
+
+        /**
+        * \brief Move assignment. See the move constructor.
+        */
+        DA<T>& operator=(DA<T>&& other);
+
         /**
         * \brief Initializes the elements of the distributed array with the value \em
         *        value.
@@ -86,7 +140,7 @@ namespace msl {
         *
         * @param f Python function.
         */
-        void mapIndexInPlace(const std::function<T(int,T)> &f);
+        void mapIndexInPlace(const std::function<T(long,T)> &f);
 
         /**
         * \brief Returns a new distributed array with a_new[i] = f(a[i]).
@@ -103,17 +157,297 @@ namespace msl {
         * @param f Python Function.
         * @return The newly created distributed array.
         */
-        DA<T> mapIndex(const std::function<T(int,T)> &f);
+        DA<T> mapIndex(const std::function<T(long,T)> &f);
+
+        /**
+        * \brief Same as map, but writes the result to \em out instead of a new distributed
+        *        array. The previous elements of \em out are discarded, its local partition is
+        *        reused. Iterative algorithms can thus alternate between two arrays without
+        *        allocating memory. With lazy evaluation, pending maps of this array that
+        *        still read \em out are applied first, so that it can keep its partition.
+        *
+        * @param f Python function.
+        * @param out Distributed array of the same size.
+        */
+        void mapTo(const std::function<T(T)> &f, DA<T>& out);
+
+        /**
+        * \brief Same as mapIndex, but writes the result to \em out (see mapTo).
+        *
+        * @param f Python function.
+        * @param out Distributed array of the same size.
+        */
+        void mapIndexTo(const std::function<T(long,T)> &f, DA<T>& out);
+
+        // SKELETONS / COMPUTATION / MAP (NATIVE FUNCTIONS)
+
+        /**
+        * \brief Same as mapInPlace, but calls the native function \em f directly in a loop
+        *        that does not need the GIL.
+        *
+        * @param f Native function, e.g. the address of a ctypes CFUNCTYPE object or a numba cfunc.
+        */
+        void mapInPlace(T (*f)(T));
+
+        /**
+        * \brief Same as mapIndexInPlace, but calls the native function \em f directly.
+        *
+        * @param f Native function, e.g. the address of a ctypes CFUNCTYPE object or a numba cfunc.
+        */
+        void mapIndexInPlace(T (*f)(long,T));
+
+        /**
+        * \brief Same as map, but calls the native function \em f directly.
+        *
+        * @param f Native function, e.g. the address of a ctypes CFUNCTYPE object or a numba cfunc.
+        * @return The newly created distributed array.
+        */
+        DA<T> map(T (*f)(T));
+
+        /**
+        * \brief Same as mapIndex, but calls the native function \em f directly.
+        *
+        * @param f Native function, e.g. the address of a ctypes CFUNCTYPE object or a numba cfunc.
+        * @return The newly created distributed array.
+        */
+        DA<T> mapIndex(T (*f)(long,T));
+
+        /**
+        * \brief Same as mapTo, but calls the native function \em f directly.
+        *
+        * @param f Native function, e.g. the address of a ctypes CFUNCTYPE object or a numba cfunc.
+        * @param out Distributed array of the same size.
+        */
+        void mapTo(T (*f)(T), DA<T>& out);
+
+        /**
+        * \brief Same as mapIndexTo, but calls the native function \em f directly.
+        *
+        * @param f Native function, e.g. the address of a ctypes CFUNCTYPE object or a numba cfunc.
+        * @param out Distributed array of the same size.
+        */
+        void mapIndexTo(T (*f)(long,T), DA<T>& out);
+
+        // SKELETONS / COMPUTATION / MAP (BATCHED)
+
+        /**
+        * \brief Replaces the local elements with f(a), where a is a NumPy array holding a
+        *        batch of consecutive local elements (see setBatchSize). f is called once per
+        *        batch instead of once per element and must return an array of the same
+        *        length. It may also modify a in place and return it.
+        *
+        * @param f Python function.
+        */
+        void mapInPlaceBatch(const std::function<detail::BatchArray<T>(py::array_t<T>)> &f);
+
+        /**
+        * \brief Replaces the local elements with f(i, a), where i is a NumPy array holding the
+        *        global indices of the batch a.
+        *
+        * @param f Python function.
+        */
+        void mapIndexInPlaceBatch(const std::function<detail::BatchArray<T>(py::array_t<long>, py::array_t<T>)> &f);
+
+        /**
+        * \brief Returns a new distributed array computed batch-wise with a_new = f(a).
+        *
+        * @param f Python function.
+        * @return The newly created distributed array.
+        */
+        DA<T> mapBatch(const std::function<detail::BatchArray<T>(py::array_t<T>)> &f);
+
+        /**
+        * \brief Returns a new distributed array computed batch-wise with a_new = f(i, a).
+        *
+        * @param f Python function.
+        * @return The newly created distributed array.
+        */
+        DA<T> mapIndexBatch(const std::function<detail::BatchArray<T>(py::array_t<long>, py::array_t<T>)> &f);
+
+
+        // SKELETONS / COMPUTATION / MAP (DISTINCT VALUES)
+
+        /**
+        * \brief Same as mapInPlace, but calls \em f only once per distinct value of the
+        *        local partition and copies the result to all elements with that value.
+        *        Much faster than mapInPlace for partitions with few distinct values
+        *        (e.g. labels or categories). \em f must not depend on side effects.
+        *
+        * @param f Python function.
+        */
+        void mapInPlaceUnique(const std::function<T(T)> &f);
+
+        /**
+        * \brief Same as map, but calls \em f only once per distinct value of the local
+        *        partition (see mapInPlaceUnique).
+        *
+        * @param f Python function.
+        * @return The newly created distributed array.
+        */
+        DA<T> mapUnique(const std::function<T(T)> &f);
+
+
+        // SKELETONS / COMPUTATION / MAP (NATIVE OPERATORS)
+
+        /**
+        * \brief Replaces each element a[i] of the distributed array with op(a[i]), where op is
+        *        a native operator applied with the scalar operands \em a and \em b (see
+        *        Operator). No Python function is called. An integer division by zero
+        *        is reported and leaves the elements unchanged.
+        *
+        * @param op The operator.
+        * @param a First scalar operand.
+        * @param b Second scalar operand.
+        */
+        void mapInPlaceOp(Operator op, const T& a = T(), const T& b = T());
+
+        /**
+        * \brief Same as above, with the operator given by its name (e.g. "mul" or "*").
+        *        Unknown names are reported and no operator is applied.
+        *
+        * @param op The name of the operator.
+        * @param a First scalar operand.
+        * @param b Second scalar operand.
+        */
+        void mapInPlaceOp(const std::string& op, const T& a = T(), const T& b = T());
+
+        /**
+        * \brief Returns a new distributed array with a_new[i] = op(a[i]).
+        *
+        * @param op The operator.
+        * @param a First scalar operand.
+        * @param b Second scalar operand.
+        * @return The newly created distributed array.
+        */
+        DA<T> mapOp(Operator op, const T& a = T(), const T& b = T());
+
+        /**
+        * \brief Same as above, with the operator given by its name (e.g. "mul" or "*").
+        *        Unknown names are reported and no operator is applied.
+        *
+        * @param op The name of the operator.
+        * @param a First scalar operand.
+        * @param b Second scalar operand.
+        * @return The newly created distributed array.
+        */
+        DA<T> mapOp(const std::string& op, const T& a = T(), const T& b = T());
+
+        /**
+        * \brief Returns a new distributed array with the elements converted to type \em R.
+        *
+        * @tparam R The new element type.
+        * @return The newly created distributed array.
+        */
+        template <typename R>
+        DA<R> mapCast();
+
+
+        // SKELETONS / COMPUTATION / MAP (EXPRESSIONS)
+
+        /**
+        * \brief Replaces each element of the distributed array with the value of the
+        *        arithmetic expression \em expr (see Expression), e.g. "x * 10 + i". The
+        *        expression may use the variables x (the element) and i (its global
+        *        index). It is compiled once and evaluated without calling back into
+        *        Python. An invalid expression is reported and leaves the elements
+        *        unchanged.
+        *
+        * @param expr The expression.
+        */
+        void mapInPlaceExpr(const std::string& expr);
+
+        /**
+        * \brief Returns a new distributed array holding the value of the arithmetic
+        *        expression \em expr for each element. For an invalid expression, it is
+        *        an unchanged copy of this one.
+        *
+        * @param expr The expression.
+        * @return The newly created distributed array.
+        */
+        DA<T> mapExpr(const std::string& expr);
+
+
+        // SKELETONS / COMPUTATION / MAP (COMPILED KERNELS)
+
+        /**
+        * \brief Replaces each element of the distributed array with f(i, row, col, x, p),
+        *        where f is C++ code compiled at runtime (see Kernel). \em body is the body
+        *        of f, e.g. "return x * 10 + i;", where x is the element, i its global index (row is 0 and col equals i)
+        *        and p points to \em params.
+        *
+        * @param body Body of the user function.
+        * @param params Parameters passed to the user function.
+        */
+        void mapInPlaceKernel(const std::string& body, const std::vector<double>& params = std::vector<double>());
+
+        /**
+        * \brief Returns a new distributed array with a_new[i] = f(i, row, col, a[i], p), where
+        *        f is C++ code compiled at runtime.
+        *
+        * @param body Body of the user function.
+        * @param params Parameters passed to the user function.
+        * @return The newly created distributed array.
+        */
+        DA<T> mapKernel(const std::string& body, const std::vector<double>& params = std::vector<double>());
+
+
+        // SKELETONS / COMPUTATION / ZIP
+
+        /**
+        * \brief Replaces each element a[i] of the distributed array with f(a[i], b[i]).
+        *        \em b must have the same size.
+        *
+        * @param b Another distributed array.
+        * @param f Python function.
+        */
+        void zipInPlace(DA<T>& b, const std::function<T(T,T)> &f);
+
+        /**
+        * \brief Returns a new distributed array with c[i] = f(a[i], b[i]).
+        *
+        * @param b Another distributed array of the same size.
+        * @param f Python function.
+        * @return The newly created distributed array.
+        */
+        DA<T> zip(DA<T>& b, const std::function<T(T,T)> &f);
+
+
+        // SKELETONS / COMPUTATION / EVALUATION
+
+        /**
+        * \brief Applies the pending maps and zips to the local partition. With lazy
+        *        evaluation (see setLazyEvaluation()), all of them are fused into one
+        *        traversal of the local partition. Called implicitly whenever the data
+        *        is accessed.
+        */
+        void evaluate();
+
+        /**
+        * \brief Evaluates the pending maps and writes the modified elements of a
+        *        memory-mapped local partition back to its file. Does nothing for
+        *        local partitions residing in main memory.
+        */
+        void flush();
 
 
-        // SKELETONS / COMMUNICATION / GATHER
+// SKELETONS / COMMUNICATION / GATHER
 
         /**
-         * \brief Transforms a distributed matrix to a numpy array.
+         * \brief Collects the distributed array in a numpy array on process
+         *        \em root. The other processes only send their local partitions
+         *        and return None.
+         *
+         * @param root The process receiving the array.
+         * @return Numpy Array on \em root, None elsewhere.
+         */
+        py::object gather(int root = 0);
+
+        /**
+         * \brief Transforms a distributed array to a numpy array on every process.
          *
          * @return Numpy Array.
          */
-        py::array_t<T> gather();
+        py::array_t<T> gatherAll();
 
 
         //
@@ -121,11 +455,13 @@ namespace msl {
         //
 
         /**
-        * \brief Returns the local partition.
+        * \brief Returns a writable NumPy array viewing the local partition without
+        *        copying it. The array keeps the distributed array alive and reflects
+        *        all later changes made by skeletons applied in place.
         *
         * @return The local partition.
         */
-        T* getLocalPartition();
+        py::array_t<T> getLocalPartition();
 
         /**
         * \briefs Sets the local partition.
@@ -134,6 +470,26 @@ namespace msl {
         */
         void setLocalPartition(py::array_t<T> array);
 
+        /**
+        * \brief Uses the memory of \em array as the local partition without copying
+        *        it. The array must be C-contiguous, writable, aligned and have exactly
+        *        getLocalSize() elements; otherwise it is copied. Changes of the array are
+        *        visible in the distributed array and vice versa.
+        *
+        * @param array Numpy Array.
+        */
+        void adoptLocalPartition(py::array_t<T> array);
+
+        /**
+        * \brief Moves the local partition to memory backed by \em pages (see
+        *        msl::setHugePages()). Copies and results of skeletons of this
+        *        distributed array use the same pages. Existing NumPy views and
+        *        the file of a memory-mapped partition are no longer connected to it.
+        *
+        * @param pages The kind of pages.
+        */
+        void setHugePages(HugePages pages);
+
         /**
         * \briefs Sets the Distributed Array.
         *
@@ -141,13 +497,46 @@ namespace msl {
         */
         void setArray(py::array_t<T> array);
 
+        /**
+        * \brief Sets the distributed array to \em array, which only process
+        *        \em root needs to hold. Each process receives just its local
+        *        partition. The other processes may pass None.
+        *
+        * @param root The process holding the array.
+        * @param array Numpy Array with at least getSize() elements (on \em root).
+        */
+        void scatterFrom(int root, py::object array);
+
         /**
         * \brief Returns the element at the given global index \em index.
         *
         * @param index The global index.
         * @return The element at the given global index.
         */
-        T get(int index) const;
+        T get(long index);
+
+        /**
+        * \brief Returns the elements at the global indices \em indices as an array of
+        *        the same shape. Unlike get(), the processes may request different
+        *        indices, but all of them must call this method. The requests are
+        *        exchanged in one all-to-all round, so reading any number of elements
+        *        takes a constant number of collective operations.
+        *
+        * @param indices The global indices.
+        * @return The elements.
+        */
+        py::array_t<T> getMany(py::array_t<long, py::array::c_style | py::array::forcecast> indices);
+
+        /**
+        * \brief Returns the elements with the global indices \em start <= i < \em stop.
+        *        The processes may request different ranges, but all of them must call
+        *        this method (see getMany()).
+        *
+        * @param start The first global index.
+        * @param stop The global index after the last one.
+        * @return The elements.
+        */
+        py::array_t<T> getRange(long start, long stop);
 
         /**
         * \brief Sets the element at the given global index \em globalIndex to the
@@ -156,14 +545,51 @@ namespace msl {
         * @param globalIndex The global index.
         * @param v The new value.
         */
-        void set(int globalIndex, const T& v);
+        void set(long globalIndex, const T& v);
+
+        /**
+        * \brief Returns the element at the global index \em index by reading it
+        *        directly from the local partition of its owner. Unlike get(), only
+        *        the calling process takes part. Remote accesses see the state of
+        *        the local partitions after the last skeleton (pending lazy maps are
+        *        not applied) and must be separated from skeletons and local accesses
+        *        by a collective operation such as msl::barrier(). The array must
+        *        have been created (or copied) in the same order relative to other
+        *        containers on all processes, otherwise the access is reported.
+        *
+        * @param index The global index.
+        * @return The element at the given global index.
+        */
+        T remoteGet(long index);
+
+        /**
+        * \brief Sets the element at the global index \em index to \em v by writing
+        *        it directly to the local partition of its owner (see remoteGet()).
+        *        Copies sharing that local partition see the new value as well.
+        *
+        * @param index The global index.
+        * @param v The new value.
+        */
+        void remotePut(long index, const T& v);
+
+        /**
+        * \brief Combines the element at the global index \em index with \em v
+        *        using \em op (ADD, MUL, MIN or MAX) in the local partition of its
+        *        owner (see remotePut()). Concurrent accumulations to the same
+        *        element with the same operator are atomic, e.g. for histograms.
+        *
+        * @param index The global index.
+        * @param v The operand.
+        * @param op The operator.
+        */
+        void accumulate(long index, const T& v, Operator op = Operator::ADD);
 
         /**
         * \brief Returns the global size of the distributed array.
         *
         * @return The global size.
         */
-        int getSize() const;
+        long getSize() const;
 
         /**
         * \brief Returns the size of local partitions of the distributed array.
@@ -177,7 +603,7 @@ namespace msl {
         *
         * @return The first (global) index.
         */
-        int getFirstIndex() const;
+        long getFirstIndex() const;
 
         /**
         * \brief Checks whether the element at the given global index \em index is
@@ -186,7 +612,7 @@ namespace msl {
         * @param index The global index.
         * @return True if the element is locally stored.
         */
-        bool isLocal(int index) const;
+        bool isLocal(long index) const;
 
         /**
         * \brief Returns the element at the given local index \em index. Note that
@@ -230,16 +656,29 @@ namespace msl {
         void printLocal();
 
     private:
+        // conversions (mapCast) access other element types
+        template <typename> friend class DA;
+
         //
         // Attributes
         //
 
-        // local partition
+        // local partition (shared with copies until either of them is written)
         T* localPartition;
+        // owner of the local partition
+        std::shared_ptr<T> buffer;
+        // number of NumPy views of the local partition (see getLocalPartition)
+        int views;
+        // pages backing the local partition
+        HugePages pages;
+        // maps and zips not yet applied to the local partition
+        detail::Pipeline<T> pipeline;
+        // local partition as accessed by the one-sided operations of other processes
+        detail::RemotePartition<T> remote;
         // position of processor in data parallel group of processors; zero-base
         int id;
         // Number of elements
-        int n;
+        long n;
         // Number of cols
         int ncol;
         // Number of rows
@@ -247,7 +686,7 @@ namespace msl {
         // Number of local elements
         int nLocal;
         // First (global) index of local partition
-        int firstIndex;
+        long firstIndex;
         // First (global) row in local partition
         int firstRow;
         // Total number of MPI processes
@@ -259,8 +698,35 @@ namespace msl {
         // AUXILIARY
         //
 
-        // initializes distributed matrix (used in constructors).
-        void init();
+        // initializes distributed matrix (used in constructors); allocates the local
+        // partition unless allocateLocal is false.
+        void init(bool allocateLocal = true);
+        // first global index of the local partition of each process, followed by the
+        // global index after the last local partition.
+        std::vector<long> partitionBounds() const;
+        // allocates a new local partition.
+        void allocate();
+        // maps the local partition from a file (see the constructor).
+        void attach(const std::string& path, bool perRank);
+        // leaves the container without elements after it has been moved from.
+        void abandon();
+        // checks whether the local partition is shared with a copy (views do not count).
+        bool isShared() const;
+        // creates a NumPy view of the local partition with the given shape.
+        py::array_t<T> localView(const std::vector<py::ssize_t>& shape);
+        // evaluates and detaches the local partition from copies before it is modified.
+        void prepareWrite();
+        // drops pending maps and detaches the local partition before it is overwritten.
+        void prepareOverwrite();
+        // evaluates the pending maps unless lazy evaluation is switched on.
+        void finishMap();
+        // makes out a copy of this array that reuses the local partition of out. Returns
+        // false if the sizes differ.
+        bool prepareDestination(DA<T>& out);
+        // process storing the element with the given global index.
+        int ownerOf(long index) const;
+        // first global index of the local partition of process rank.
+        long firstIndexOf(int rank) const;
     };
 }
 
@@ -0,0 +1,109 @@
+/*
+ * batch.h
+ *
+ * Helpers for the batched (NumPy-vectorized) map skeletons of DA and DM.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include "../muesli.h"
+
+namespace py = pybind11;
+
+namespace msl {
+
+namespace detail {
+
+/**
+ * \brief Array type returned by batch functions. Results are converted to the
+ *        element type and to C order once per batch, not once per element.
+ */
+template <typename T>
+using BatchArray = py::array_t<T, py::array::c_style | py::array::forcecast>;
+
+/**
+ * \brief Returns the number of elements per batch for a local partition of
+ *        \em nLocal elements.
+ */
+inline int batchSize(int nLocal)
+{
+  if (Muesli::batch_size > 0 && Muesli::batch_size < nLocal) {
+    return Muesli::batch_size;
+  }
+  return nLocal;
+}
+
+/**
+ * \brief Wraps \em count elements starting at \em data in a NumPy array without
+ *        copying. The view is only valid for the duration of the batch call.
+ */
+template <typename T>
+inline py::array_t<T> batchView(T* data, int count)
+{
+  // a non-owning base object prevents pybind11 from copying the data
+  py::capsule base(data, [](void*) {});
+  return py::array_t<T>({count}, {(py::ssize_t) sizeof(T)}, data, base);
+}
+
+/**
+ * \brief Creates a NumPy array holding \em count consecutive indices starting
+ *        at \em first.
+ */
+inline py::array_t<long> batchIndices(long first, int count)
+{
+  py::array_t<long> indices(count);
+  long* ptr = indices.mutable_data();
+  for (int j = 0; j < count; j++) {
+    ptr[j] = first + j;
+  }
+  return indices;
+}
+
+/**
+ * \brief Creates NumPy arrays holding the row and column of \em count
+ *        consecutive elements starting at global index \em first in a matrix
+ *        with \em ncol columns.
+ */
+inline void batchRowsCols(long first, int count, int ncol, py::array_t<int>& rows, py::array_t<int>& cols)
+{
+  rows = py::array_t<int>(count);
+  cols = py::array_t<int>(count);
+  int* r = rows.mutable_data();
+  int* c = cols.mutable_data();
+  int row = (int) (first / ncol);
+  int col = (int) (first % ncol);
+  for (int j = 0; j < count; j++) {
+    r[j] = row;
+    c[j] = col;
+    if (++col == ncol) {
+      col = 0;
+      row++;
+    }
+  }
+}
+
+/**
+ * \brief Writes the result of a batch function back to \em count elements
+ *        starting at \em dest. Results that are views of \em dest itself (i.e.
+ *        the function worked in place) are not copied.
+ */
+template <typename T>
+inline void batchStore(const BatchArray<T>& result, T* dest, int count)
+{
+  if (result.size() != count) {
+    throws(IllegalPartitionException());
+    return;
+  }
+  const T* src = result.data();
+  if (src != dest) {
+    std::copy(src, src + count, dest);
+  }
+}
+
+}
+
+}
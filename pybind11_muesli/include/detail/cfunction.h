@@ -0,0 +1,168 @@
+/*
+ * cfunction.h
+ *
+ * Support for native user functions (ctypes function pointers and numba
+ * cfuncs) in the map skeletons of DA and DM.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <pybind11/pybind11.h>
+#include <pybind11/functional.h>
+
+#include "../muesli.h"
+
+namespace py = pybind11;
+
+namespace msl {
+
+namespace detail {
+
+/**
+ * \brief Name of the ctypes type corresponding to \em T. Only defined for the
+ *        element types that may appear in the signature of a native function.
+ */
+template <typename T> struct CTypesName;
+template <> struct CTypesName<std::int8_t> { static const char* get() { return "c_int8"; } };
+template <> struct CTypesName<std::int16_t> { static const char* get() { return "c_int16"; } };
+template <> struct CTypesName<int> { static const char* get() { return "c_int"; } };
+template <> struct CTypesName<std::int64_t> { static const char* get() { return "c_int64"; } };
+template <> struct CTypesName<std::uint8_t> { static const char* get() { return "c_uint8"; } };
+template <> struct CTypesName<std::uint16_t> { static const char* get() { return "c_uint16"; } };
+template <> struct CTypesName<std::uint32_t> { static const char* get() { return "c_uint32"; } };
+template <> struct CTypesName<std::uint64_t> { static const char* get() { return "c_uint64"; } };
+template <> struct CTypesName<float> { static const char* get() { return "c_float"; } };
+template <> struct CTypesName<double> { static const char* get() { return "c_double"; } };
+
+/**
+ * \brief Function pointer and std::function types for a signature \em Sig.
+ */
+template <typename Sig> struct CFunction;
+
+template <typename R, typename... Args>
+struct CFunction<R(Args...)>
+{
+  typedef R (*pointer)(Args...);
+  typedef std::function<R(Args...)> function;
+
+  // e.g. "c_int(c_int, c_int)"
+  static std::string signature()
+  {
+    std::string s = std::string(CTypesName<R>::get()) + "(";
+    const char* args[] = {CTypesName<Args>::get()...};
+    for (size_t i = 0; i < sizeof...(Args); i++) {
+      s += (i > 0 ? ", " : "") + std::string(args[i]);
+    }
+    return s + ")";
+  }
+
+  // checks restype and argtypes of a ctypes function pointer
+  static bool matches(const py::object& ctypes, const py::object& proto)
+  {
+    if (!proto.attr("restype").is(ctypes.attr(CTypesName<R>::get()))) {
+      return false;
+    }
+    py::object argtypes = proto.attr("argtypes");
+    if (argtypes.is_none() || py::len(argtypes) != sizeof...(Args)) {
+      return false;
+    }
+    const char* args[] = {CTypesName<Args>::get()...};
+    for (size_t i = 0; i < sizeof...(Args); i++) {
+      if (!argtypes[py::int_(i)].is(ctypes.attr(args[i]))) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+/**
+ * \brief Returns true if the ctypes function pointer \em proto calls back into
+ *        Python, i.e. it was created by applying a CFUNCTYPE to a Python
+ *        callable. ctypes keeps the thunk of such a callback in _objects.
+ */
+inline bool wrapsPython(const py::object& proto)
+{
+  py::object objects = proto.attr("_objects");
+  if (!py::isinstance<py::dict>(objects)) {
+    return false;
+  }
+  for (auto item : py::reinterpret_borrow<py::dict>(objects)) {
+    if (py::str(item.second.get_type().attr("__name__")).cast<std::string>() == "CThunkObject") {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * \brief Returns the address of \em f if it is a native function, i.e. a ctypes
+ *        function pointer to native code (e.g. a symbol of a library loaded with
+ *        ctypes.CDLL) or a numba cfunc, whose declared signature is \em Sig.
+ *        Returns nullptr for Python callables, including ctypes callbacks that
+ *        wrap one: they need the GIL, which native skeletons do not hold. A
+ *        native function with a different signature is reported and nullptr is
+ *        returned, so that it is called through Python instead.
+ *
+ * @param f The user function.
+ * @return The function pointer or nullptr.
+ */
+template <typename Sig>
+typename CFunction<Sig>::pointer cFunction(const py::object& f)
+{
+  py::object ctypes = py::module::import("ctypes");
+  py::object proto = f;
+  std::uintptr_t address = 0;
+
+  // numba cfuncs expose their address and a ctypes wrapper
+  bool numba = py::hasattr(f, "address") && py::hasattr(f, "ctypes");
+  if (numba) {
+    proto = f.attr("ctypes");
+  }
+  if (!py::isinstance(proto, ctypes.attr("_CFuncPtr")) || (!numba && wrapsPython(proto))) {
+    return nullptr;
+  }
+  if (!CFunction<Sig>::matches(ctypes, proto)) {
+    throws(IllegalSignatureException(CFunction<Sig>::signature()));
+    return nullptr;
+  }
+
+  if (numba) {
+    address = f.attr("address").cast<std::uintptr_t>();
+  } else {
+    address = ctypes.attr("cast")(proto, ctypes.attr("c_void_p")).attr("value").cast<std::uintptr_t>();
+  }
+  return reinterpret_cast<typename CFunction<Sig>::pointer>(address);
+}
+
+/**
+ * \brief Creates the binding of a skeleton that accepts both native functions
+ *        and Python callables. Native functions are passed to \em native, which
+ *        runs without the GIL; everything else is passed to \em python. Further
+ *        arguments of the skeleton (e.g. a destination) are passed on unchanged.
+ *
+ * @param native Skeleton taking a function pointer.
+ * @param python Skeleton taking a std::function.
+ * @return Function object to be bound with pybind11.
+ */
+template <typename Sig, typename C, typename Ret, typename... Args>
+std::function<Ret(C&, const py::object&, Args...)> nativeOrPython(
+    Ret (C::*native)(typename CFunction<Sig>::pointer, Args...),
+    Ret (C::*python)(const typename CFunction<Sig>::function&, Args...))
+{
+  return [native, python](C& c, const py::object& f, Args... args) -> Ret {
+    typename CFunction<Sig>::pointer fp = cFunction<Sig>(f);
+    if (fp != nullptr) {
+      py::gil_scoped_release release;
+      return (c.*native)(fp, args...);
+    }
+    return (c.*python)(f.cast<typename CFunction<Sig>::function>(), args...);
+  };
+}
+
+}
+
+}
@@ -223,6 +223,138 @@ private:
   std::string feature;
 };
 
+class UnknownOperatorException: public Exception
+{
+public:
+  UnknownOperatorException(std::string o)
+          : op(o)
+  {
+  }
+
+  std::string tostring() const
+  {
+    return "UnknownOperatorException: " + op;
+  }
+
+private:
+  std::string op;
+};
+
+class IllegalSignatureException: public Exception
+{
+public:
+  IllegalSignatureException(std::string s)
+          : signature(s)
+  {
+  }
+
+  std::string tostring() const
+  {
+    return "IllegalSignatureException: expected native function " + signature;
+  }
+
+private:
+  std::string signature;
+};
+
+class IllegalExpressionException: public Exception
+{
+public:
+  IllegalExpressionException(std::string m)
+          : message(m)
+  {
+  }
+
+  std::string tostring() const
+  {
+    return "IllegalExpressionException: " + message;
+  }
+
+private:
+  std::string message;
+};
+
+class KernelCompilationException: public Exception
+{
+public:
+  KernelCompilationException(std::string m)
+          : message(m)
+  {
+  }
+
+  std::string tostring() const
+  {
+    return "KernelCompilationException: " + message;
+  }
+
+private:
+  std::string message;
+};
+
+class IllegalArrayException: public Exception
+{
+public:
+  IllegalArrayException(std::string m)
+          : message(m)
+  {
+  }
+
+  std::string tostring() const
+  {
+    return "IllegalArrayException: " + message;
+  }
+
+private:
+  std::string message;
+};
+
+class UnknownFieldException: public Exception
+{
+public:
+  UnknownFieldException(std::string f)
+          : field(f)
+  {
+  }
+
+  std::string tostring() const
+  {
+    return "UnknownFieldException: " + field;
+  }
+
+private:
+  std::string field;
+};
+
+class FileMappingException: public Exception
+{
+public:
+  FileMappingException(std::string f, std::string r)
+          : file(f), reason(r)
+  {
+  }
+
+  std::string tostring() const
+  {
+    return "FileMappingException: " + file + ": " + reason;
+  }
+
+private:
+  std::string file;
+  std::string reason;
+};
+
+class DivisionByZeroException: public Exception
+{
+
+public:
+
+  std::string tostring() const
+  {
+    return "DivisionByZeroException";
+  }
+
+};
+
 class NoSolutionException: public Exception
 {
 
@@ -0,0 +1,184 @@
+/*
+ * exchange.h
+ *
+ * Reading many elements of a distributed container at once. Instead of one
+ * broadcast per element, the requests of all processes are grouped by the
+ * process owning the elements and answered in a single all-to-all round.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <memory>
+#include <vector>
+
+#include "../muesli.h"
+#include "../threadpool.h"
+#include "message.h"
+
+namespace msl {
+
+namespace detail {
+
+/**
+ * \brief Checks that [\em start, \em stop) is a range of global indices of a
+ *        container whose partitions are bounded by \em bounds (see
+ *        fetchElements()). Otherwise, the error is reported and the range is
+ *        made empty.
+ */
+inline bool checkRange(long& start, long& stop, const std::vector<long>& bounds)
+{
+  if (start < 0 || stop > bounds.back() || start > stop) {
+    throws(IllegalGetException());
+    start = stop = 0;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * \brief Writes the elements at the global indices \em indices[0, \em count) of
+ *        a container to \em out. Process p stores the elements with the global
+ *        indices [bounds[p], bounds[p + 1]) in its local partition; that of this
+ *        process is \em partition. The processes may request different indices.
+ *        Indices out of range are reported and yield T(). Collective.
+ */
+template <typename T>
+void fetchElements(const T* partition, const std::vector<long>& bounds, const long* indices, size_t count, T* out)
+{
+  int np = (int) bounds.size() - 1;
+  long first = bounds[Muesli::proc_id];
+
+  // group the requests by owner
+  std::vector<int> owners(count);
+  std::vector<int> sendCounts(np, 0);
+  bool valid = true;
+  for (size_t k = 0; k < count; k++) {
+    long index = indices[k];
+    if (index < 0 || index >= bounds[np]) {
+      owners[k] = -1;
+      out[k] = T();
+      valid = false;
+      continue;
+    }
+    owners[k] = (int) (std::upper_bound(bounds.begin(), bounds.end(), index) - bounds.begin()) - 1;
+    sendCounts[owners[k]]++;
+  }
+  if (!valid) {
+    throws(IllegalGetException());
+  }
+  std::vector<int> sendDispls(np, 0);
+  for (int p = 1; p < np; p++) {
+    sendDispls[p] = sendDispls[p - 1] + sendCounts[p - 1];
+  }
+  int requested = np > 0 ? sendDispls[np - 1] + sendCounts[np - 1] : 0;
+  std::vector<long> requests(requested);
+  // position in out of each request
+  std::vector<size_t> positions(requested);
+  std::vector<int> next(sendDispls);
+  for (size_t k = 0; k < count; k++) {
+    if (owners[k] >= 0) {
+      int slot = next[owners[k]]++;
+      requests[slot] = indices[k];
+      positions[slot] = k;
+    }
+  }
+
+  // exchange the requests
+  std::vector<int> recvCounts(np);
+  alltoall(sendCounts.data(), recvCounts.data(), 1);
+  std::vector<int> recvDispls(np, 0);
+  for (int p = 1; p < np; p++) {
+    recvDispls[p] = recvDispls[p - 1] + recvCounts[p - 1];
+  }
+  int received = np > 0 ? recvDispls[np - 1] + recvCounts[np - 1] : 0;
+  std::vector<long> wanted(received);
+  alltoallv(requests.data(), sendCounts.data(), sendDispls.data(), wanted.data(), recvCounts.data(), recvDispls.data());
+
+  // answer them
+  std::vector<T> values(received);
+  T* v = values.data();
+  const long* w = wanted.data();
+  parallelFor(received, ThreadPool::GRAIN, [partition, first, v, w](int begin, int end) {
+    for (int j = begin; j < end; j++) {
+      v[j] = partition[w[j] - first];
+    }
+  });
+  std::vector<T> replies(requested);
+  alltoallv(values.data(), recvCounts.data(), recvDispls.data(), replies.data(), sendCounts.data(), sendDispls.data());
+  for (int slot = 0; slot < requested; slot++) {
+    out[positions[slot]] = replies[slot];
+  }
+}
+
+/**
+ * \brief Writes the elements with the global indices [\em start, \em stop) of a
+ *        container to \em out (see fetchElements()). The processes may request
+ *        different ranges. Only the bounds of the ranges are exchanged; the
+ *        elements are sent directly from the local partitions. Ranges of more
+ *        than INT_MAX elements are exchanged point to point. Collective.
+ */
+template <typename T>
+void fetchRange(const T* partition, const std::vector<long>& bounds, long start, long stop, T* out)
+{
+  int np = (int) bounds.size() - 1;
+  int id = Muesli::proc_id;
+  long range[2] = {start, stop};
+  std::vector<long> ranges(2 * np);
+  allgather(range, ranges.data(), 2);
+
+  // elements of p requested by this process go to out[received[p], received[p + 1])
+  std::vector<long> received(np + 1);
+  for (int p = 0; p <= np; p++) {
+    received[p] = std::min(std::max(bounds[p], start), stop) - start;
+  }
+  // elements of this process requested by p, relative to the local partition
+  std::vector<long> sendBegin(np), sendEnd(np);
+  bool fits = true;
+  for (int p = 0; p < np; p++) {
+    sendBegin[p] = std::max(ranges[2 * p], bounds[id]) - bounds[id];
+    sendEnd[p] = std::max(std::min(ranges[2 * p + 1], bounds[id + 1]) - bounds[id], sendBegin[p]);
+    fits = fits && ranges[2 * p + 1] - ranges[2 * p] <= INT_MAX;
+  }
+
+  if (fits) {
+    std::vector<int> sendCounts(np), sendDispls(np), recvCounts, recvDispls;
+    for (int p = 0; p < np; p++) {
+      sendCounts[p] = (int) (sendEnd[p] - sendBegin[p]);
+      sendDispls[p] = sendCounts[p] > 0 ? (int) sendBegin[p] : 0;
+    }
+    vectorCounts(received.data(), np, recvCounts, recvDispls);
+    alltoallv(partition, sendCounts.data(), sendDispls.data(), out, recvCounts.data(), recvDispls.data());
+    return;
+  }
+
+  // the displacements of some range exceed an int (all processes agree on this,
+  // since they know all ranges)
+  std::vector<MPI_Request> requests;
+  std::vector<std::unique_ptr<Message>> messages;
+  for (int p = 0; p < np; p++) {
+    long count = received[p + 1] - received[p];
+    if (p != id && count > 0) {
+      messages.emplace_back(new Message(count * sizeof(T)));
+      requests.emplace_back();
+      MPI_Irecv(out + received[p], messages.back()->count, messages.back()->type, p, MYTAG, MPI_COMM_WORLD,
+                &requests.back());
+    }
+  }
+  for (int p = 0; p < np; p++) {
+    long count = sendEnd[p] - sendBegin[p];
+    if (p != id && count > 0) {
+      messages.emplace_back(new Message(count * sizeof(T)));
+      requests.emplace_back();
+      MPI_Isend(partition + sendBegin[p], messages.back()->count, messages.back()->type, p, MYTAG, MPI_COMM_WORLD,
+                &requests.back());
+    }
+  }
+  std::copy(partition + sendBegin[id], partition + sendEnd[id], out + received[id]);
+  MPI_Waitall((int) requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+}
+
+}
+
+}
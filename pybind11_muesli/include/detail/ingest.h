@@ -0,0 +1,131 @@
+/*
+ * ingest.h
+ *
+ * Copying NumPy arrays into local partitions (setArray, setMatrix,
+ * setLocalPartition). The array is validated once; the elements are then
+ * copied in bulk by the threads of the process, without the GIL.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include "../muesli.h"
+#include "../threadpool.h"
+
+namespace py = pybind11;
+
+namespace msl {
+
+namespace detail {
+
+/**
+ * \brief Number of elements per chunk of a threaded copy.
+ */
+static const int COPY_GRAIN = 1 << 16;
+
+/**
+ * \brief Checks whether \em array has at least \em size elements. Reports
+ *        an error otherwise.
+ */
+template <typename T, int Flags>
+bool checkArray(const py::array_t<T, Flags>& array, py::ssize_t size)
+{
+  if (array.size() < size) {
+    throws(IllegalArrayException("expected at least " + std::to_string(size) +
+                                 " elements, got " + std::to_string(array.size())));
+    return false;
+  }
+  return true;
+}
+
+/**
+ * \brief Copies the elements [first, first + count) of \em array, taken in C
+ *        (row-major) order, to \em dest. Contiguous arrays are copied with
+ *        memcpy, all others (e.g. Fortran-ordered arrays or slices) with a
+ *        strided copy. The array must be checked with checkArray() before.
+ *        Must be called with the GIL held; it is released during the copy.
+ *
+ * @param array The array.
+ * @param first Index of the first element in C order.
+ * @param dest Destination of \em count elements.
+ * @param count Number of elements.
+ */
+template <typename T>
+void copyFromArray(const py::array_t<T>& array, py::ssize_t first, T* dest, int count)
+{
+  const char* base = reinterpret_cast<const char*>(array.data());
+  int ndim = (int) array.ndim();
+  std::vector<py::ssize_t> shape(array.shape(), array.shape() + ndim);
+  std::vector<py::ssize_t> strides(array.strides(), array.strides() + ndim);
+  bool contiguous = (array.flags() & py::array::c_style) != 0;
+
+  py::gil_scoped_release release;
+  if (contiguous) {
+    const T* src = reinterpret_cast<const T*>(base) + first;
+    parallelFor(count, COPY_GRAIN, [src, dest](int begin, int end) {
+      std::memcpy(dest + begin, src + begin, (end - begin) * sizeof(T));
+    });
+    return;
+  }
+
+  parallelFor(count, COPY_GRAIN, [&](int begin, int end) {
+    // position of element first + begin
+    std::vector<py::ssize_t> index(ndim);
+    py::ssize_t flat = first + begin;
+    py::ssize_t offset = 0;
+    for (int d = ndim - 1; d >= 0; d--) {
+      index[d] = flat % shape[d];
+      flat /= shape[d];
+      offset += index[d] * strides[d];
+    }
+    for (int k = begin; k < end; k++) {
+      std::memcpy(dest + k, base + offset, sizeof(T));
+      // advance to the next element in C order
+      for (int d = ndim - 1; d >= 0; d--) {
+        offset += strides[d];
+        if (++index[d] < shape[d]) {
+          break;
+        }
+        offset -= strides[d] * shape[d];
+        index[d] = 0;
+      }
+    }
+  });
+}
+
+/**
+ * \brief Checks whether the memory of \em array can be adopted as a local
+ *        partition of \em count elements, i.e. whether it is C-contiguous,
+ *        writable, suitably aligned and has exactly \em count elements.
+ */
+template <typename T>
+bool adoptable(const py::array_t<T>& array, int count)
+{
+  return array.size() == count && (array.flags() & py::array::c_style) != 0 && array.writeable() &&
+         reinterpret_cast<std::uintptr_t>(array.data()) % alignof(T) == 0;
+}
+
+/**
+ * \brief Returns a shared pointer to the memory of \em array that keeps the
+ *        array alive until the last owner releases it.
+ */
+template <typename T>
+std::shared_ptr<T> adopt(py::array_t<T>& array)
+{
+  py::object* keep = new py::object(array);
+  return std::shared_ptr<T>(array.mutable_data(), [keep](T*) {
+    py::gil_scoped_acquire acquire;
+    delete keep;
+  });
+}
+
+}
+
+}
@@ -0,0 +1,78 @@
+/*
+ * mapping.h
+ *
+ * Local partitions backed by memory-mapped files. The operating system pages
+ * the elements in and out on demand, so a container may be larger than the
+ * main memory of the nodes.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace msl {
+
+namespace detail {
+
+/**
+ * \brief Access pattern of a skeleton, passed to the operating system as a
+ *        hint for read-ahead.
+ */
+enum class Access { SEQUENTIAL, RANDOM };
+
+/**
+ * \brief Creates the file \em path if necessary and extends it to at least
+ *        \em bytes bytes. Existing contents are kept. Returns false and sets
+ *        errno on failure.
+ */
+bool reserveFile(const std::string& path, size_t bytes);
+
+/**
+ * \brief Maps \em bytes bytes of the file \em path starting at byte \em offset,
+ *        which need not be page aligned. The file is created or extended as
+ *        needed. Returns nullptr and sets errno on failure.
+ */
+void* mapFile(const std::string& path, size_t offset, size_t bytes);
+
+/**
+ * \brief Unmaps a region returned by mapFile(). Dirty pages are written back by
+ *        the operating system.
+ */
+void unmapFile(void* region);
+
+/**
+ * \brief Tells the operating system how the mapped region starting at
+ *        \em region will be accessed. Does nothing if \em region was not
+ *        returned by mapFile().
+ */
+void advise(const void* region, Access access);
+
+/**
+ * \brief Writes the dirty pages of the mapped region starting at \em region
+ *        back to its file and waits for completion. Does nothing if \em region
+ *        was not returned by mapFile().
+ */
+void flushMapping(const void* region);
+
+/**
+ * \brief Returns a local partition of \em count elements stored in the file
+ *        \em path starting at byte \em offset, or nullptr on failure. The
+ *        elements are the bytes of the file; T must be trivially copyable.
+ */
+template <typename T>
+std::shared_ptr<T> mapPartition(const std::string& path, size_t offset, int count)
+{
+  T* partition = static_cast<T*>(mapFile(path, offset, count * sizeof(T)));
+  if (partition == nullptr) {
+    return std::shared_ptr<T>();
+  }
+  return std::shared_ptr<T>(partition, [](T* p) {
+    unmapFile(p);
+  });
+}
+
+}
+
+}
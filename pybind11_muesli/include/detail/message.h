@@ -0,0 +1,94 @@
+/*
+ * message.h
+ *
+ * MPI counts are ints, so a message of more than INT_MAX bytes cannot be
+ * described as a number of MPI_BYTEs. Such messages are described as one
+ * element of a derived datatype instead.
+ */
+
+#pragma once
+
+#include <climits>
+#include <cstddef>
+#include <vector>
+#include <mpi.h>
+
+namespace msl {
+
+namespace detail {
+
+/**
+ * \brief Class Message describes a message of \em bytes bytes as \em count
+ *        elements of \em type, where \em count fits into an int. Messages up to
+ *        INT_MAX bytes are sent as MPI_BYTEs, larger ones as a single element of
+ *        a derived datatype made of 1 GiB chunks and a remainder. The extent of
+ *        the datatype equals the size of the message, so it may also describe the
+ *        contribution of each process to a collective operation.
+ *
+ * The datatype is freed on destruction. MPI keeps it alive for non-blocking
+ * operations that are still pending.
+ */
+class Message
+{
+public:
+  explicit Message(size_t bytes) : type(MPI_BYTE), count((int) bytes), derived(false)
+  {
+    if (bytes <= (size_t) INT_MAX) {
+      return;
+    }
+    const size_t CHUNK = (size_t) 1 << 30;
+    size_t chunks = bytes / CHUNK;
+    size_t rest = bytes % CHUNK;
+    MPI_Datatype chunk, body;
+    MPI_Type_contiguous((int) CHUNK, MPI_BYTE, &chunk);
+    MPI_Type_contiguous((int) chunks, chunk, &body);
+    int lengths[2] = {1, (int) rest};
+    MPI_Aint displacements[2] = {0, (MPI_Aint) (chunks * CHUNK)};
+    MPI_Datatype types[2] = {body, MPI_BYTE};
+    MPI_Type_create_struct(2, lengths, displacements, types, &type);
+    MPI_Type_commit(&type);
+    MPI_Type_free(&body);
+    MPI_Type_free(&chunk);
+    count = 1;
+    derived = true;
+  }
+
+  ~Message()
+  {
+    if (derived) {
+      MPI_Type_free(&type);
+    }
+  }
+
+  Message(const Message&) = delete;
+  Message& operator=(const Message&) = delete;
+
+  MPI_Datatype type;
+  int count;
+
+private:
+  bool derived;
+};
+
+/**
+ * \brief Converts the bounds of the contributions to a vector collective
+ *        (process p contributes the elements bounds[p] <= i < bounds[p + 1])
+ *        into counts and displacements. Returns false if they exceed an int.
+ */
+inline bool vectorCounts(const long* bounds, int np, std::vector<int>& counts, std::vector<int>& displs)
+{
+  if (bounds[np] > INT_MAX) {
+    return false;
+  }
+  counts.resize(np);
+  displs.resize(np);
+  for (int p = 0; p < np; p++) {
+    counts[p] = (int) (bounds[p + 1] - bounds[p]);
+    displs[p] = (int) bounds[p];
+  }
+  return true;
+}
+
+}
+
+}
@@ -0,0 +1,67 @@
+/*
+ * partition.h
+ *
+ * Block distribution of the elements of a container over the processes. If
+ * the number of elements is not divisible by the number of processes, the
+ * first n % np processes store one element more than the others, so that no
+ * element is left out.
+ */
+
+#pragma once
+
+#include <vector>
+
+namespace msl {
+
+namespace detail {
+
+/**
+ * \brief Returns the number of elements that process \em rank stores of \em n
+ *        elements distributed over \em np processes.
+ */
+inline int partitionSize(long n, int np, int rank)
+{
+  return (int) (n / np + (rank < n % np ? 1 : 0));
+}
+
+/**
+ * \brief Returns the global index of the first element that process \em rank
+ *        stores (\em n for \em rank = \em np).
+ */
+inline long partitionStart(long n, int np, int rank)
+{
+  long rest = n % np;
+  return (long) rank * (n / np) + (rank < rest ? rank : rest);
+}
+
+/**
+ * \brief Returns the process storing the element with the global index
+ *        \em index, with 0 <= \em index < \em n.
+ */
+inline int partitionOwner(long n, int np, long index)
+{
+  long size = n / np;
+  long rest = n % np;
+  // the first rest processes store size + 1 elements
+  long large = rest * (size + 1);
+  if (index < large) {
+    return (int) (index / (size + 1));
+  }
+  return (int) (rest + (index - large) / size);
+}
+
+/**
+ * \brief Returns the first global index of each process followed by \em n.
+ */
+inline std::vector<long> partitionBounds(long n, int np)
+{
+  std::vector<long> bounds(np + 1);
+  for (int rank = 0; rank <= np; rank++) {
+    bounds[rank] = partitionStart(n, np, rank);
+  }
+  return bounds;
+}
+
+}
+
+}
@@ -0,0 +1,128 @@
+/*
+ * pipeline.h
+ *
+ * Pending map stages of a DA or DM. Stages are fused into a single traversal
+ * of the local partition when the container is evaluated.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include "../threadpool.h"
+
+namespace msl {
+
+namespace detail {
+
+/**
+ * \brief Class Pipeline holds the map stages that have not yet been applied
+ *        to a local partition.
+ *
+ * A stage transforms a block of consecutive elements in place. run() walks over
+ * the partition once and applies all stages to each block while it is still
+ * in cache, so a chain of N maps reads and writes memory once instead of N
+ * times. If all stages are native (i.e. do not call back into Python), the
+ * blocks are distributed among the threads of the process.
+ *
+ * \tparam T Element type.
+ */
+template <typename T>
+class Pipeline
+{
+public:
+  /**
+   * \brief A stage applied in place to \em count elements, where \em firstIndex
+   *        is the global index of block[0].
+   */
+  typedef std::function<void(T* block, int count, long firstIndex)> Stage;
+
+  /**
+   * \brief Number of elements per block.
+   */
+  static const int BLOCK = 4096;
+
+  /**
+   * \brief Number of elements per chunk scheduled to a thread if the cost of a
+   *        stage may vary strongly from element to element (e.g. native user
+   *        functions and compiled kernels).
+   */
+  static const int FINE_BLOCK = 256;
+
+  Pipeline() : native(true), grain(BLOCK) {}
+
+  bool empty() const
+  {
+    return stages.empty();
+  }
+
+  /**
+   * \brief Appends \em stage. A native stage may be applied to several blocks
+   *        concurrently; \em chunk is the number of elements it is scheduled in.
+   */
+  void push(const Stage& stage, bool isNative, int chunk = BLOCK)
+  {
+    stages.push_back(stage);
+    native = native && isNative;
+    grain = std::min(grain, chunk);
+  }
+
+  /**
+   * \brief Appends the stages of \em other after the stages of this pipeline.
+   */
+  void append(const Pipeline& other)
+  {
+    stages.insert(stages.end(), other.stages.begin(), other.stages.end());
+    native = native && other.native;
+    grain = std::min(grain, other.grain);
+  }
+
+  void clear()
+  {
+    stages.clear();
+    native = true;
+    grain = BLOCK;
+  }
+
+  /**
+   * \brief Applies all stages to \em count elements of \em src starting at
+   *        global index \em firstIndex and writes the results to \em dest.
+   *        \em src and \em dest may be the same buffer.
+   */
+  void run(const T* src, T* dest, int count, long firstIndex) const
+  {
+    if (!native) {
+      runRange(src, dest, 0, count, firstIndex);
+      return;
+    }
+    parallelFor(count, grain, [this, src, dest, firstIndex](int begin, int end) {
+      runRange(src, dest, begin, end, firstIndex);
+    });
+  }
+
+private:
+  void runRange(const T* src, T* dest, int begin, int end, long firstIndex) const
+  {
+    for (int k = begin; k < end; k += BLOCK) {
+      int n = std::min(BLOCK, end - k);
+      if (src != dest) {
+        std::copy(src + k, src + k + n, dest + k);
+      }
+      for (const Stage& stage : stages) {
+        stage(dest + k, n, firstIndex + k);
+      }
+    }
+  }
+
+  std::vector<Stage> stages;
+  // true if no stage calls back into Python
+  bool native;
+  // number of elements per chunk scheduled to a thread
+  int grain;
+};
+
+}
+
+}
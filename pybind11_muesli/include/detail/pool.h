@@ -0,0 +1,113 @@
+/*
+ * pool.h
+ *
+ * Memory of local partitions. Blocks are 64-byte aligned and recycled by size
+ * class, so that iterative applications which repeatedly create containers of
+ * the same size reuse memory instead of allocating (and page faulting) it anew.
+ * Large blocks may be backed by huge pages, which reduces TLB misses of
+ * strided traversals.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+#include "../threadpool.h"
+
+namespace msl {
+
+/**
+ * \brief Pages backing local partitions. Huge pages are only used for
+ *        partitions of at least one huge page (2 MiB).
+ */
+enum class HugePages {
+  NONE,        // pages of the default size
+  TRANSPARENT, // transparent huge pages (madvise(MADV_HUGEPAGE)), if enabled by the system
+  EXPLICIT     // huge pages reserved by the administrator (MAP_HUGETLB), else transparent ones
+};
+
+namespace detail {
+
+/**
+ * \brief Alignment of local partitions (one cache line).
+ */
+static const size_t PARTITION_ALIGNMENT = 64;
+
+/**
+ * \brief Size of a huge page.
+ */
+static const size_t HUGE_PAGE = (size_t) 2 << 20;
+
+/**
+ * \brief Returns a 64-byte aligned block of at least \em bytes bytes, reusing a
+ *        released block of the same size class and kind of pages if possible.
+ *        On return, \em pages holds the kind of pages actually used, which
+ *        falls back to smaller pages if the requested ones are not available.
+ */
+void* allocateBlock(size_t bytes, HugePages& pages);
+
+/**
+ * \brief Returns a block obtained from allocateBlock(\em bytes, \em pages) to
+ *        the pool. The pool keeps a few blocks per size class and kind of pages;
+ *        further blocks are freed right away.
+ */
+void releaseBlock(void* block, size_t bytes, HugePages pages);
+
+/**
+ * \brief Frees all blocks held by the pool.
+ */
+void clearPool();
+
+/**
+ * \brief Returns the number of bytes held by the pool for reuse.
+ */
+size_t pooledBytes();
+
+/**
+ * \brief Touches the pages of \em count elements at \em partition in parallel
+ *        with the threads of the pool. Each page is placed on the NUMA node of
+ *        the thread that touches it first, which is the thread whose range of
+ *        later parallel traversals contains it. Pages already in use stay where
+ *        they are.
+ */
+template <typename T>
+void touchPages(T* partition, int count)
+{
+  const size_t PAGE = 4096;
+  char* first = reinterpret_cast<char*>(partition);
+  parallelFor(count, ThreadPool::GRAIN, [first](int begin, int end) {
+    size_t from = reinterpret_cast<size_t>(first + (size_t) begin * sizeof(T));
+    size_t to = reinterpret_cast<size_t>(first + (size_t) end * sizeof(T));
+    for (size_t page = (from + PAGE - 1) / PAGE * PAGE; page < to; page += PAGE) {
+      *reinterpret_cast<volatile char*>(page) = 0;
+    }
+  });
+}
+
+/**
+ * \brief Allocates a local partition of \em count default-initialized elements
+ *        backed by \em pages. It is returned to the pool when its last owner
+ *        releases it. The partition consists of \em segments parts of equal
+ *        size traversed in parallel one after the other (e.g. the planes of a
+ *        SoADM); the pages of each part are placed near the threads working on
+ *        them.
+ */
+template <typename T>
+std::shared_ptr<T> allocatePartition(int count, HugePages pages = HugePages::NONE, int segments = 1)
+{
+  size_t bytes = (count > 0 ? count : 1) * sizeof(T);
+  T* partition = static_cast<T*>(allocateBlock(bytes, pages));
+  for (int s = 0; s < segments; s++) {
+    touchPages(partition + (size_t) count / segments * s, count / segments);
+  }
+  std::uninitialized_default_construct_n(partition, count);
+  return std::shared_ptr<T>(partition, [count, bytes, pages](T* p) {
+    std::destroy_n(p, count);
+    releaseBlock(p, bytes, pages);
+  });
+}
+
+}
+
+}
@@ -0,0 +1,432 @@
+/*
+ * rma.h
+ *
+ * One-sided communication (MPI-3 RMA) used by the skeletons that access the
+ * local partitions of other processes without their participation.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <complex>
+#include <cstdint>
+#include <mpi.h>
+
+namespace msl {
+
+namespace detail {
+
+/**
+ * \brief Class SharedCounter represents a counter stored on process \em root
+ *        that all processes increment atomically. It hands out consecutive
+ *        work items (e.g. chunks of rows) to whichever process asks first.
+ *
+ * Construction and destruction are collective operations.
+ */
+class SharedCounter
+{
+public:
+  explicit SharedCounter(int root = 0) : root(root), value(0)
+  {
+    int id;
+    MPI_Comm_rank(MPI_COMM_WORLD, &id);
+    MPI_Win_create(&value, id == root ? sizeof(value) : 0, sizeof(value), MPI_INFO_NULL, MPI_COMM_WORLD, &window);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, window);
+  }
+
+  ~SharedCounter()
+  {
+    MPI_Win_unlock_all(window);
+    MPI_Win_free(&window);
+  }
+
+  SharedCounter(const SharedCounter&) = delete;
+  SharedCounter& operator=(const SharedCounter&) = delete;
+
+  /**
+   * \brief Returns the current value and increments the counter.
+   */
+  int next()
+  {
+    int one = 1, result;
+    MPI_Fetch_and_op(&one, &result, MPI_INT, root, 0, MPI_SUM, window);
+    MPI_Win_flush(root, window);
+    return result;
+  }
+
+private:
+  int root;
+  int value;
+  MPI_Win window;
+};
+
+/**
+ * \brief Class Window exposes \em count elements of type \em T of each process
+ *        for one-sided access by all processes. Elements are addressed by
+ *        process and offset into its buffer.
+ *
+ * Construction and destruction are collective operations. Between them, the
+ * exposed buffers must only be accessed through get() and put().
+ */
+template <typename T>
+class Window
+{
+public:
+  Window(T* base, int count)
+  {
+    // counts are given in elements, so that they do not overflow as bytes
+    MPI_Type_contiguous((int) sizeof(T), MPI_BYTE, &element);
+    MPI_Type_commit(&element);
+    MPI_Win_create(base, (MPI_Aint) count * sizeof(T), sizeof(T), MPI_INFO_NULL, MPI_COMM_WORLD, &window);
+    MPI_Win_lock_all(0, window);
+  }
+
+  ~Window()
+  {
+    MPI_Win_unlock_all(window);
+    MPI_Win_free(&window);
+    MPI_Type_free(&element);
+  }
+
+  Window(const Window&) = delete;
+  Window& operator=(const Window&) = delete;
+
+  /**
+   * \brief Copies \em count elements starting at \em offset on process \em rank
+   *        to \em dest. Completes before returning.
+   */
+  void get(T* dest, int rank, int offset, int count)
+  {
+    MPI_Get(dest, count, element, rank, offset, count, element, window);
+    MPI_Win_flush(rank, window);
+  }
+
+  /**
+   * \brief Copies \em count elements of \em src to \em offset on process
+   *        \em rank. Completes before returning.
+   */
+  void put(const T* src, int rank, int offset, int count)
+  {
+    MPI_Put(src, count, element, rank, offset, count, element, window);
+    MPI_Win_flush(rank, window);
+  }
+
+private:
+  MPI_Win window;
+  MPI_Datatype element;
+};
+
+/**
+ * \brief Opens the dynamic window through which the local partitions of all
+ *        containers are accessed by one-sided operations (used by
+ *        initSkeletons()). Collective. If MPI offers no dynamic windows, the
+ *        window stays MPI_WIN_NULL, which is reported for more than one process.
+ */
+void openPartitionWindow();
+
+/**
+ * \brief Detaches all memory from the window and frees it (used by
+ *        terminateSkeletons()). Collective.
+ */
+void closePartitionWindow();
+
+/**
+ * \brief Returns the window of the local partitions, or MPI_WIN_NULL if it is
+ *        not open.
+ */
+MPI_Win partitionWindow();
+
+/**
+ * \brief Attaches \em bytes bytes at \em base to the window of the local
+ *        partitions. A region attached several times (e.g. a partition shared by
+ *        copies) is only attached once and detached with its last user.
+ */
+void attachRegion(void* base, size_t bytes);
+
+/**
+ * \brief Releases a region attached by attachRegion().
+ */
+void detachRegion(void* base);
+
+/**
+ * \brief Location of the local partition of a container, kept in a slot of the
+ *        header table of each process (see RemotePartition). \em id identifies
+ *        the container, so that an access to a slot reused by another one is
+ *        detected.
+ */
+struct PartitionHeader
+{
+  MPI_Aint base;
+  long id;
+  int count;
+};
+
+/**
+ * \brief Claims a free slot of the header table of this process for a new
+ *        container, assigns the container its id and initializes the header to
+ *        an empty partition. Slots and ids are handed out in a fixed order, so a
+ *        container created (or copied) in the same order on all processes gets
+ *        the same slot and id everywhere. Local. Returns -1 (and reports it) if
+ *        all slots are in use.
+ */
+int claimHeader(long& id);
+
+/**
+ * \brief Returns a slot obtained from claimHeader().
+ */
+void releaseHeader(int slot);
+
+/**
+ * \brief Returns the header in \em slot of this process.
+ */
+PartitionHeader& localHeader(int slot);
+
+/**
+ * \brief Reads the header in \em slot of process \em rank. Requires the window.
+ */
+PartitionHeader remoteHeader(int rank, int slot);
+
+/**
+ * \brief The MPI datatype of an element type.
+ */
+template <typename T> struct MpiType;
+template <> struct MpiType<std::int8_t> { static MPI_Datatype get() { return MPI_INT8_T; } };
+template <> struct MpiType<std::int16_t> { static MPI_Datatype get() { return MPI_INT16_T; } };
+template <> struct MpiType<std::int32_t> { static MPI_Datatype get() { return MPI_INT32_T; } };
+template <> struct MpiType<std::int64_t> { static MPI_Datatype get() { return MPI_INT64_T; } };
+template <> struct MpiType<std::uint8_t> { static MPI_Datatype get() { return MPI_UINT8_T; } };
+template <> struct MpiType<std::uint16_t> { static MPI_Datatype get() { return MPI_UINT16_T; } };
+template <> struct MpiType<std::uint32_t> { static MPI_Datatype get() { return MPI_UINT32_T; } };
+template <> struct MpiType<std::uint64_t> { static MPI_Datatype get() { return MPI_UINT64_T; } };
+template <> struct MpiType<float> { static MPI_Datatype get() { return MPI_FLOAT; } };
+template <> struct MpiType<double> { static MPI_Datatype get() { return MPI_DOUBLE; } };
+template <> struct MpiType<std::complex<float>> { static MPI_Datatype get() { return MPI_C_FLOAT_COMPLEX; } };
+template <> struct MpiType<std::complex<double>> { static MPI_Datatype get() { return MPI_C_DOUBLE_COMPLEX; } };
+
+/**
+ * \brief Class RemotePartition makes the local partition of a container
+ *        accessible to one-sided operations of all processes.
+ *
+ * The partition is attached to the window of the local partitions. Since it
+ * moves whenever the container detaches from a copy or is reallocated, its
+ * current address and size are kept in a header. Each process has a table of
+ * headers at a fixed address, exchanged once when the window is opened, and a
+ * container uses the same slot of this table on all processes (see
+ * claimHeader()). An access first reads the header of the target and then the
+ * elements, so the target does not take part and may even have moved its
+ * partition since.
+ *
+ * Opening, copying and exposing are local operations. Remote accesses must be
+ * separated from skeletons applied to the target container by a collective
+ * operation (e.g. msl::barrier()), and they fail if the container was not
+ * created in the same order on the target. Without a window, only the local
+ * partition of the calling process is accessible.
+ */
+template <typename T>
+class RemotePartition
+{
+public:
+  RemotePartition() : slot(-1), id(0), partition(nullptr) {}
+
+  RemotePartition(const RemotePartition& other) : slot(-1), id(0), partition(nullptr)
+  {
+    if (other.slot >= 0) {
+      open();
+      expose(other.partition, localHeader(other.slot).count);
+    }
+  }
+
+  RemotePartition(RemotePartition&& other) : slot(other.slot), id(other.id), partition(other.partition)
+  {
+    other.slot = -1;
+    other.partition = nullptr;
+  }
+
+  RemotePartition& operator=(const RemotePartition& other)
+  {
+    if (this != &other && other.slot >= 0) {
+      if (slot < 0) {
+        open();
+      }
+      expose(other.partition, localHeader(other.slot).count);
+    }
+    return *this;
+  }
+
+  RemotePartition& operator=(RemotePartition&& other)
+  {
+    if (this != &other) {
+      close();
+      slot = other.slot;
+      id = other.id;
+      partition = other.partition;
+      other.slot = -1;
+      other.partition = nullptr;
+    }
+    return *this;
+  }
+
+  ~RemotePartition()
+  {
+    close();
+  }
+
+  /**
+   * \brief Claims the header of this container. Without a free header, the
+   *        container is not accessible remotely.
+   */
+  void open()
+  {
+    slot = claimHeader(id);
+  }
+
+  /**
+   * \brief Exposes the \em count elements at \em base as the local partition
+   *        instead of the previous one.
+   */
+  void expose(T* base, int count)
+  {
+    if (slot < 0) {
+      return;
+    }
+    if (partition != nullptr) {
+      detachRegion(partition);
+    }
+    PartitionHeader& header = localHeader(slot);
+    partition = count > 0 ? base : nullptr;
+    if (partition != nullptr) {
+      attachRegion(partition, (size_t) count * sizeof(T));
+      MPI_Get_address(partition, &header.base);
+    } else {
+      header.base = 0;
+    }
+    header.count = partition != nullptr ? count : 0;
+  }
+
+  /**
+   * \brief Copies \em count elements starting at \em offset in the local
+   *        partition of process \em rank to \em dest. Returns false if they
+   *        are out of range.
+   */
+  bool get(T* dest, int rank, int offset, int count)
+  {
+    if (partitionWindow() == MPI_WIN_NULL) {
+      T* local = localElements(rank, offset, count);
+      if (local == nullptr) {
+        return false;
+      }
+      std::copy(local, local + count, dest);
+      return true;
+    }
+    MPI_Aint address;
+    if (!locate(rank, offset, count, address)) {
+      return false;
+    }
+    MPI_Win window = partitionWindow();
+    MPI_Get(dest, count * sizeof(T), MPI_BYTE, rank, address, count * sizeof(T), MPI_BYTE, window);
+    MPI_Win_flush(rank, window);
+    return true;
+  }
+
+  /**
+   * \brief Copies \em count elements of \em src to \em offset in the local
+   *        partition of process \em rank. Returns false if they are out of
+   *        range.
+   */
+  bool put(const T* src, int rank, int offset, int count)
+  {
+    if (partitionWindow() == MPI_WIN_NULL) {
+      T* local = localElements(rank, offset, count);
+      if (local == nullptr) {
+        return false;
+      }
+      std::copy(src, src + count, local);
+      return true;
+    }
+    MPI_Aint address;
+    if (!locate(rank, offset, count, address)) {
+      return false;
+    }
+    MPI_Win window = partitionWindow();
+    MPI_Put(src, count * sizeof(T), MPI_BYTE, rank, address, count * sizeof(T), MPI_BYTE, window);
+    MPI_Win_flush(rank, window);
+    return true;
+  }
+
+  /**
+   * \brief Combines \em count elements of \em src with the elements at
+   *        \em offset in the local partition of process \em rank using
+   *        \em op. Concurrent accumulations with the same operation are
+   *        atomic per element. Returns false if they are out of range.
+   */
+  bool accumulate(const T* src, int rank, int offset, int count, MPI_Op op)
+  {
+    if (partitionWindow() == MPI_WIN_NULL) {
+      T* local = localElements(rank, offset, count);
+      if (local == nullptr) {
+        return false;
+      }
+      MPI_Reduce_local(src, local, count, MpiType<T>::get(), op);
+      return true;
+    }
+    MPI_Aint address;
+    if (!locate(rank, offset, count, address)) {
+      return false;
+    }
+    MPI_Win window = partitionWindow();
+    MPI_Accumulate(src, count, MpiType<T>::get(), rank, address, count, MpiType<T>::get(), op, window);
+    MPI_Win_flush(rank, window);
+    return true;
+  }
+
+private:
+  void close()
+  {
+    if (slot < 0) {
+      return;
+    }
+    if (partition != nullptr) {
+      detachRegion(partition);
+      partition = nullptr;
+    }
+    releaseHeader(slot);
+    slot = -1;
+  }
+
+  // the elements of the local partition if rank is this process (used without a window)
+  T* localElements(int rank, int offset, int count)
+  {
+    int rankSelf;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rankSelf);
+    if (slot < 0 || rank != rankSelf || offset < 0 || count < 0 || offset + count > localHeader(slot).count) {
+      return nullptr;
+    }
+    return partition + offset;
+  }
+
+  // reads the header of rank and returns the address of the element at offset
+  bool locate(int rank, int offset, int count, MPI_Aint& address)
+  {
+    if (slot < 0 || partitionWindow() == MPI_WIN_NULL) {
+      return false;
+    }
+    PartitionHeader target = remoteHeader(rank, slot);
+    // the slot belongs to another container if they were created in a
+    // different order on rank
+    if (target.id != id || offset < 0 || count < 0 || offset + count > target.count) {
+      return false;
+    }
+    address = MPI_Aint_add(target.base, (MPI_Aint) offset * sizeof(T));
+    return true;
+  }
+
+  // slot of the header of this container (-1 if not opened)
+  int slot;
+  // id of this container, equal on all processes
+  long id;
+  // currently exposed local partition
+  T* partition;
+};
+}
+
+}
@@ -0,0 +1,54 @@
+/*
+ * topology.h
+ *
+ * CPUs and NUMA nodes of the machine as listed in /sys, used to pin the threads
+ * of the processes so that each thread works on memory of its own NUMA node.
+ */
+
+#pragma once
+
+#include <vector>
+
+namespace msl {
+
+namespace detail {
+
+/**
+ * \brief Returns the CPUs of each NUMA node as listed in /sys/devices/system/node.
+ *        Without NUMA information, all online CPUs form a single node.
+ */
+std::vector<std::vector<int>> numaNodes();
+
+/**
+ * \brief Returns all CPUs of the machine ordered by NUMA node.
+ */
+std::vector<int> nodeCpus();
+
+/**
+ * \brief Returns the CPUs the calling thread may run on (e.g. as restricted by
+ *        mpirun) ordered by NUMA node.
+ */
+std::vector<int> allowedCpus();
+
+/**
+ * \brief Restricts the calling thread to \em cpu. Returns false if the
+ *        operating system refuses.
+ */
+bool pinThread(int cpu);
+
+/**
+ * \brief Returns the CPUs the calling thread may run on in ascending order.
+ *        Unlike allowedCpus(), no NUMA information is read.
+ */
+std::vector<int> threadAffinity();
+
+/**
+ * \brief Restricts the calling thread to \em cpus, e.g. to restore an affinity
+ *        returned by threadAffinity(). Returns false if the operating system
+ *        refuses.
+ */
+bool pinThread(const std::vector<int>& cpus);
+
+}
+
+}
@@ -0,0 +1,107 @@
+/*
+ * types.h
+ *
+ * Element types for which distributed arrays and matrices are bound to
+ * Python, and the features available for each of them.
+ */
+
+#pragma once
+
+#include <complex>
+#include <cstdint>
+#include <type_traits>
+
+namespace msl {
+
+namespace detail {
+
+/**
+ * \brief A list of element types.
+ */
+template <typename... Ts> struct TypeList {};
+
+/**
+ * \brief The element types bound to Python: the NumPy dtypes int8 to int64,
+ *        uint8 to uint64, float32, float64, complex64 and complex128.
+ */
+typedef TypeList<std::int8_t, std::int16_t, std::int32_t, std::int64_t,
+                 std::uint8_t, std::uint16_t, std::uint32_t, std::uint64_t,
+                 float, double, std::complex<float>, std::complex<double>> ElementTypes;
+
+/**
+ * \brief Name of an element type in the names of the Python classes (e.g.
+ *        "int" for intDA) and an alternative name following NumPy (e.g. "int32"
+ *        for int32DA), or nullptr if both are the same.
+ */
+template <typename T> struct ElementName;
+template <> struct ElementName<std::int8_t> {
+  static const char* name() { return "int8"; }
+  static const char* alias() { return nullptr; }
+};
+template <> struct ElementName<std::int16_t> {
+  static const char* name() { return "int16"; }
+  static const char* alias() { return nullptr; }
+};
+template <> struct ElementName<std::int32_t> {
+  static const char* name() { return "int"; }
+  static const char* alias() { return "int32"; }
+};
+template <> struct ElementName<std::int64_t> {
+  static const char* name() { return "int64"; }
+  static const char* alias() { return nullptr; }
+};
+template <> struct ElementName<std::uint8_t> {
+  static const char* name() { return "uint8"; }
+  static const char* alias() { return nullptr; }
+};
+template <> struct ElementName<std::uint16_t> {
+  static const char* name() { return "uint16"; }
+  static const char* alias() { return nullptr; }
+};
+template <> struct ElementName<std::uint32_t> {
+  static const char* name() { return "uint32"; }
+  static const char* alias() { return nullptr; }
+};
+template <> struct ElementName<std::uint64_t> {
+  static const char* name() { return "uint64"; }
+  static const char* alias() { return nullptr; }
+};
+template <> struct ElementName<float> {
+  static const char* name() { return "float"; }
+  static const char* alias() { return "float32"; }
+};
+template <> struct ElementName<double> {
+  static const char* name() { return "double"; }
+  static const char* alias() { return "float64"; }
+};
+template <> struct ElementName<std::complex<float>> {
+  static const char* name() { return "complex64"; }
+  static const char* alias() { return nullptr; }
+};
+template <> struct ElementName<std::complex<double>> {
+  static const char* name() { return "complex128"; }
+  static const char* alias() { return nullptr; }
+};
+
+/**
+ * \brief Whether the ordered arithmetic of an element type is available, i.e.
+ *        operators, expressions, compiled kernels, native functions, casts and
+ *        the maps over distinct values. Complex types only support the maps
+ *        with Python functions, zips and communication.
+ */
+template <typename T>
+struct HasArithmetic : std::is_arithmetic<T> {};
+
+/**
+ * \brief Returns \em x in a form that prints as a number (8-bit integers would
+ *        otherwise print as characters).
+ */
+template <typename T>
+inline auto printable(const T& x) -> decltype(+x)
+{
+  return +x;
+}
+
+}
+
+}
@@ -0,0 +1,48 @@
+/*
+ * unique.h
+ *
+ * Helpers for the maps that call the user function once per distinct value of
+ * a local partition (mapUnique, mapInPlaceUnique).
+ */
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+namespace msl {
+
+namespace detail {
+
+/**
+ * \brief Finds the distinct values of \em count elements of \em in in order of
+ *        their first occurrence. Afterwards, in[k] == values[codes[k]].
+ *
+ * @param in The elements.
+ * @param count Number of elements.
+ * @param values Distinct values (output).
+ * @param codes Index into \em values of each element (output, \em count entries).
+ */
+template <typename T>
+void uniqueValues(const T* in, int count, std::vector<T>& values, std::vector<int>& codes)
+{
+  std::unordered_map<T, int> index;
+  values.clear();
+  codes.resize(count);
+  for (int k = 0; k < count; k++) {
+    // runs of equal values are common in label data
+    if (k > 0 && in[k] == in[k - 1]) {
+      codes[k] = codes[k - 1];
+      continue;
+    }
+    auto it = index.emplace(in[k], (int) values.size());
+    if (it.second) {
+      values.push_back(in[k]);
+    }
+    codes[k] = it.first->second;
+  }
+}
+
+}
+
+}
@@ -1,12 +1,28 @@
 #pragma once
 
+#include <memory>
+#include <string>
 #include <type_traits>
 #include "muesli.h"
 #include "detail/exception.h"
+#include "detail/exchange.h"
+#include "detail/ingest.h"
+#include "detail/batch.h"
+#include "detail/cfunction.h"
+#include "detail/mapping.h"
+#include "detail/partition.h"
+#include "detail/pipeline.h"
+#include "detail/pool.h"
+#include "detail/types.h"
+#include "detail/rma.h"
+#include "detail/unique.h"
+#include "operators.h"
+#include "expression.h"
+#include "jit.h"
+#include "threadpool.h"
 #include <pybind11/pybind11.h>
 #include <pybind11/functional.h>
 #include <pybind11/numpy.h>
-#include <openacc.h>
 
 namespace py = pybind11;
 
@@ -53,11 +69,51 @@ public:
     */
     DM(int col, int row, const T& initial_value);
 
+    /**
+    * \brief Creates a distributed matrix whose local partitions are memory-mapped
+    *        from files, so that it may be larger than the main memory. Each
+    *        process maps the slice of \em path holding its local partition (the
+    *        file holds the matrix in row-major order) or, if \em perRank is true,
+    *        the whole file \em path.<rank>. Files are created or extended as
+    *        needed; the elements they already contain are kept. Maps in place and
+    *        mapTo() write through to the files, whereas copies and the results of
+    *        other skeletons reside in main memory.
+    *
+    * @param row amount of rows of the distributed matrix.
+    * @param col amount of columns of the distributed matrix.
+    * @param path Path of the file.
+    * @param perRank Whether each process maps a file of its own.
+    */
+    DM(int row, int col, const std::string& path, bool perRank = false);
+
     /**
     * \brief Destructor.
     */
     ~DM();
 
+    /**
+    * \brief Copy constructor. The copy shares the local partition with \em other
+    *        until either of them is modified. NumPy views of \em other do not
+    *        carry over, so they never see writes to the copy.
+    */
+    DM(const DM<T>& other);
+
+    /**
+    * \brief Move constructor. Takes over the local partition of \em other,
+    *        which is left empty (without elements).
+    */
+    DM(DM<T>&& other);
+
+    /**
+    * \brief Copy assignment. See the copy constructor.
+    */
+    DM<T>& operator=(const DM<T>& other);
+
+    /**
+    * \brief Move assignment. See the move constructor.
+    */
+    DM<T>& operator=(DM<T>&& other);
+
     /**
     * \brief Initializes the elements of the distributed matrix with the value \em
     *        value.
@@ -87,7 +143,7 @@ public:
     *
     * @param f Python function.
     */
-    void mapIndexInPlace(const std::function<T(int,T)> &f);
+    void mapIndexInPlace(const std::function<T(long,T)> &f);
 
     /**
     * \brief Replaces each element a[i] of the distributed matrix with f(row, column, a[i]).
@@ -116,7 +172,7 @@ public:
     * @param f Python Function.
     * @return The newly created distributed matrix.
     */
-    DM<T> mapIndex(const std::function<T(int,T)> &f);
+    DM<T> mapIndex(const std::function<T(long,T)> &f);
 
     /**
     * \brief Returns a new distributed matrix with a_new[i] = f(row, column, a[i]). Note
@@ -127,15 +183,405 @@ public:
     */
     DM<T> mapIndex2(const std::function<T(int,int,T)> &f);
 
+    /**
+    * \brief Same as map, but writes the result to \em out instead of a new distributed
+    *        matrix. The previous elements of \em out are discarded, its local partition
+    *        is reused. Iterative algorithms can thus alternate between two matrices
+    *        without allocating memory. With lazy evaluation, pending maps of this matrix that
+    *        still read \em out are applied first, so that it can keep its partition.
+    *
+    * @param f Python function.
+    * @param out Distributed matrix with the same number of rows and columns.
+    */
+    void mapTo(const std::function<T(T)> &f, DM<T>& out);
+
+    /**
+    * \brief Same as mapIndex, but writes the result to \em out (see mapTo).
+    *
+    * @param f Python function.
+    * @param out Distributed matrix with the same number of rows and columns.
+    */
+    void mapIndexTo(const std::function<T(long,T)> &f, DM<T>& out);
+
+    /**
+    * \brief Same as mapIndex2, but writes the result to \em out (see mapTo).
+    *
+    * @param f Python function.
+    * @param out Distributed matrix with the same number of rows and columns.
+    */
+    void mapIndex2To(const std::function<T(int,int,T)> &f, DM<T>& out);
+
+    // SKELETONS / COMPUTATION / MAP (NATIVE FUNCTIONS)
+
+    /**
+    * \brief Same as mapInPlace, but calls the native function \em f directly in a loop
+    *        that does not need the GIL.
+    *
+    * @param f Native function, e.g. the address of a ctypes CFUNCTYPE object or a numba cfunc.
+    */
+    void mapInPlace(T (*f)(T));
+
+    /**
+    * \brief Same as mapIndexInPlace, but calls the native function \em f directly.
+    *
+    * @param f Native function, e.g. the address of a ctypes CFUNCTYPE object or a numba cfunc.
+    */
+    void mapIndexInPlace(T (*f)(long,T));
+
+    /**
+    * \brief Same as mapIndexInPlace2, but calls the native function \em f directly.
+    *
+    * @param f Native function, e.g. the address of a ctypes CFUNCTYPE object or a numba cfunc.
+    */
+    void mapIndexInPlace2(T (*f)(int,int,T));
+
+    /**
+    * \brief Same as mapIndexInPlaceM, but calls the native function \em f directly.
+    *
+    * @param f Native function, e.g. the address of a ctypes CFUNCTYPE object or a numba cfunc.
+    */
+    void mapIndexInPlaceM(T (*f)(int,int,T));
+
+    /**
+    * \brief Same as map, but calls the native function \em f directly.
+    *
+    * @param f Native function, e.g. the address of a ctypes CFUNCTYPE object or a numba cfunc.
+    * @return The newly created distributed matrix.
+    */
+    DM<T> map(T (*f)(T));
+
+    /**
+    * \brief Same as mapIndex, but calls the native function \em f directly.
+    *
+    * @param f Native function, e.g. the address of a ctypes CFUNCTYPE object or a numba cfunc.
+    * @return The newly created distributed matrix.
+    */
+    DM<T> mapIndex(T (*f)(long,T));
+
+    /**
+    * \brief Same as mapIndex2, but calls the native function \em f directly.
+    *
+    * @param f Native function, e.g. the address of a ctypes CFUNCTYPE object or a numba cfunc.
+    * @return The newly created distributed matrix.
+    */
+    DM<T> mapIndex2(T (*f)(int,int,T));
+
+    /**
+    * \brief Same as mapTo, but calls the native function \em f directly.
+    *
+    * @param f Native function, e.g. the address of a ctypes CFUNCTYPE object or a numba cfunc.
+    * @param out Distributed matrix with the same number of rows and columns.
+    */
+    void mapTo(T (*f)(T), DM<T>& out);
 
-    // SKELETONS / COMMUNICATION / GATHER
+    /**
+    * \brief Same as mapIndexTo, but calls the native function \em f directly.
+    *
+    * @param f Native function, e.g. the address of a ctypes CFUNCTYPE object or a numba cfunc.
+    * @param out Distributed matrix with the same number of rows and columns.
+    */
+    void mapIndexTo(T (*f)(long,T), DM<T>& out);
 
     /**
-     * \brief Transforms a distributed matrix to a numpy array.
+    * \brief Same as mapIndex2To, but calls the native function \em f directly.
+    *
+    * @param f Native function, e.g. the address of a ctypes CFUNCTYPE object or a numba cfunc.
+    * @param out Distributed matrix with the same number of rows and columns.
+    */
+    void mapIndex2To(T (*f)(int,int,T), DM<T>& out);
+
+    // SKELETONS / COMPUTATION / MAP (DYNAMIC LOAD BALANCING)
+
+    /**
+    * \brief Same as mapIndexInPlaceM, but distributes the work dynamically among the
+    *        processes. Chunks of rows are handed out by a shared counter to whichever
+    *        process is idle; it fetches the elements from their owners, applies \em f
+    *        and writes the results back. Use it if the cost of \em f varies strongly
+    *        across the matrix (e.g. for Mandelbrot images), so that the runtime tracks
+    *        the average instead of the slowest partition. Collective operation.
+    *
+    * @param f Python function.
+    */
+    void mapIndexInPlaceMDynamic(const std::function<T(int,int,T)> &f);
+
+    /**
+    * \brief Same as mapIndexInPlaceMDynamic, but calls the native function \em f
+    *        directly, using all threads of a process.
+    *
+    * @param f Native function, e.g. the address of a ctypes CFUNCTYPE object or a numba cfunc.
+    */
+    void mapIndexInPlaceMDynamic(T (*f)(int,int,T));
+
+    /**
+    * \brief Same as mapIndex2, but distributes the work dynamically among the
+    *        processes (see mapIndexInPlaceMDynamic).
+    *
+    * @param f Python function.
+    * @return The newly created distributed matrix.
+    */
+    DM<T> mapIndex2Dynamic(const std::function<T(int,int,T)> &f);
+
+    /**
+    * \brief Same as mapIndex2Dynamic, but calls the native function \em f directly.
+    *
+    * @param f Native function, e.g. the address of a ctypes CFUNCTYPE object or a numba cfunc.
+    * @return The newly created distributed matrix.
+    */
+    DM<T> mapIndex2Dynamic(T (*f)(int,int,T));
+
+    // SKELETONS / COMPUTATION / MAP (BATCHED)
+
+    /**
+    * \brief Replaces the local elements with f(a), where a is a NumPy array holding a
+    *        batch of consecutive local elements (see setBatchSize). f is called once per
+    *        batch instead of once per element and must return an array of the same
+    *        length. It may also modify a in place and return it.
+    *
+    * @param f Python function.
+    */
+    void mapInPlaceBatch(const std::function<detail::BatchArray<T>(py::array_t<T>)> &f);
+
+    /**
+    * \brief Replaces the local elements with f(i, a), where i is a NumPy array holding the
+    *        global indices of the batch a.
+    *
+    * @param f Python function.
+    */
+    void mapIndexInPlaceBatch(const std::function<detail::BatchArray<T>(py::array_t<long>, py::array_t<T>)> &f);
+
+    /**
+    * \brief Replaces the local elements with f(row, column, a), where row and column are
+    *        NumPy arrays holding the rows and columns of the batch a.
+    *
+    * @param f Python function.
+    */
+    void mapIndexInPlace2Batch(const std::function<detail::BatchArray<T>(py::array_t<int>, py::array_t<int>, py::array_t<T>)> &f);
+
+    /**
+    * \brief Returns a new distributed matrix computed batch-wise with a_new = f(a).
+    *
+    * @param f Python function.
+    * @return The newly created distributed matrix.
+    */
+    DM<T> mapBatch(const std::function<detail::BatchArray<T>(py::array_t<T>)> &f);
+
+    /**
+    * \brief Returns a new distributed matrix computed batch-wise with a_new = f(i, a).
+    *
+    * @param f Python function.
+    * @return The newly created distributed matrix.
+    */
+    DM<T> mapIndexBatch(const std::function<detail::BatchArray<T>(py::array_t<long>, py::array_t<T>)> &f);
+
+    /**
+    * \brief Returns a new distributed matrix computed batch-wise with
+    *        a_new = f(row, column, a).
+    *
+    * @param f Python function.
+    * @return The newly created distributed matrix.
+    */
+    DM<T> mapIndex2Batch(const std::function<detail::BatchArray<T>(py::array_t<int>, py::array_t<int>, py::array_t<T>)> &f);
+
+
+    // SKELETONS / COMPUTATION / MAP (DISTINCT VALUES)
+
+    /**
+    * \brief Same as mapInPlace, but calls \em f only once per distinct value of the
+    *        local partition and copies the result to all elements with that value.
+    *        Much faster than mapInPlace for partitions with few distinct values
+    *        (e.g. labels or categories). \em f must not depend on side effects.
+    *
+    * @param f Python function.
+    */
+    void mapInPlaceUnique(const std::function<T(T)> &f);
+
+    /**
+    * \brief Same as map, but calls \em f only once per distinct value of the local
+    *        partition (see mapInPlaceUnique).
+    *
+    * @param f Python function.
+    * @return The newly created distributed matrix.
+    */
+    DM<T> mapUnique(const std::function<T(T)> &f);
+
+
+    // SKELETONS / COMPUTATION / MAP (NATIVE OPERATORS)
+
+    /**
+    * \brief Replaces each element a[i] of the distributed matrix with op(a[i]), where op is
+    *        a native operator applied with the scalar operands \em a and \em b (see
+    *        Operator). No Python function is called. An integer division by zero
+    *        is reported and leaves the elements unchanged.
+    *
+    * @param op The operator.
+    * @param a First scalar operand.
+    * @param b Second scalar operand.
+    */
+    void mapInPlaceOp(Operator op, const T& a = T(), const T& b = T());
+
+    /**
+    * \brief Same as above, with the operator given by its name (e.g. "mul" or "*").
+    *        Unknown names are reported and no operator is applied.
+    *
+    * @param op The name of the operator.
+    * @param a First scalar operand.
+    * @param b Second scalar operand.
+    */
+    void mapInPlaceOp(const std::string& op, const T& a = T(), const T& b = T());
+
+    /**
+    * \brief Returns a new distributed matrix with a_new[i] = op(a[i]).
+    *
+    * @param op The operator.
+    * @param a First scalar operand.
+    * @param b Second scalar operand.
+    * @return The newly created distributed matrix.
+    */
+    DM<T> mapOp(Operator op, const T& a = T(), const T& b = T());
+
+    /**
+    * \brief Same as above, with the operator given by its name (e.g. "mul" or "*").
+    *        Unknown names are reported and no operator is applied.
+    *
+    * @param op The name of the operator.
+    * @param a First scalar operand.
+    * @param b Second scalar operand.
+    * @return The newly created distributed matrix.
+    */
+    DM<T> mapOp(const std::string& op, const T& a = T(), const T& b = T());
+
+    /**
+    * \brief Returns a new distributed matrix with the elements converted to type \em R.
+    *
+    * @tparam R The new element type.
+    * @return The newly created distributed matrix.
+    */
+    template <typename R>
+    DM<R> mapCast();
+
+
+    // SKELETONS / COMPUTATION / MAP (EXPRESSIONS)
+
+    /**
+    * \brief Replaces each element of the distributed matrix with the value of the
+    *        arithmetic expression \em expr (see Expression), e.g. "x * 10 + i". The
+    *        expression may use the variables x (the element), i (its global index),
+    *        row and col. It is compiled once and evaluated without calling back into
+    *        Python. An invalid expression is reported and leaves the elements
+    *        unchanged.
+    *
+    * @param expr The expression.
+    */
+    void mapInPlaceExpr(const std::string& expr);
+
+    /**
+    * \brief Returns a new distributed matrix holding the value of the arithmetic
+    *        expression \em expr for each element. For an invalid expression, it is
+    *        an unchanged copy of this one.
+    *
+    * @param expr The expression.
+    * @return The newly created distributed matrix.
+    */
+    DM<T> mapExpr(const std::string& expr);
+
+
+    // SKELETONS / COMPUTATION / MAP (COMPILED KERNELS)
+
+    /**
+    * \brief Replaces each element of the distributed matrix with f(i, row, col, x, p),
+    *        where f is C++ code compiled at runtime (see Kernel). \em body is the body
+    *        of f, e.g. "return x * 10 + i;", where x is the element, i its global index, row and col its position
+    *        and p points to \em params.
+    *
+    * @param body Body of the user function.
+    * @param params Parameters passed to the user function.
+    */
+    void mapInPlaceKernel(const std::string& body, const std::vector<double>& params = std::vector<double>());
+
+    /**
+    * \brief Returns a new distributed matrix with a_new[i] = f(i, row, col, a[i], p), where
+    *        f is C++ code compiled at runtime.
+    *
+    * @param body Body of the user function.
+    * @param params Parameters passed to the user function.
+    * @return The newly created distributed matrix.
+    */
+    DM<T> mapKernel(const std::string& body, const std::vector<double>& params = std::vector<double>());
+
+
+    // SKELETONS / COMPUTATION / ZIP
+
+    /**
+    * \brief Replaces each element a[i] of the distributed matrix with f(a[i], b[i]).
+    *        \em b must have the same dimensions.
+    *
+    * @param b Another distributed matrix.
+    * @param f Python function.
+    */
+    void zipInPlace(DM<T>& b, const std::function<T(T,T)> &f);
+
+    /**
+    * \brief Returns a new distributed matrix with c[i] = f(a[i], b[i]).
+    *
+    * @param b Another distributed matrix of the same dimensions.
+    * @param f Python function.
+    * @return The newly created distributed matrix.
+    */
+    DM<T> zip(DM<T>& b, const std::function<T(T,T)> &f);
+
+
+    // SKELETONS / COMPUTATION / EVALUATION
+
+    /**
+    * \brief Applies the pending maps and zips to the local partition. With lazy
+    *        evaluation (see setLazyEvaluation()), all of them are fused into one
+    *        traversal of the local partition. Called implicitly whenever the data
+    *        is accessed.
+    */
+    void evaluate();
+
+    /**
+    * \brief Evaluates the pending maps and writes the modified elements of a
+    *        memory-mapped local partition back to its file. Does nothing for
+    *        local partitions residing in main memory.
+    */
+    void flush();
+
+
+// SKELETONS / COMMUNICATION / GATHER
+
+    /**
+     * \brief Collects the distributed matrix in a numpy array of shape
+     *        (rows, cols) on process \em root. The other processes only send
+     *        their local partitions and return None.
+     *
+     * @param root The process receiving the array.
+     * @return Numpy Array on \em root, None elsewhere.
+     */
+    py::object gather(int root = 0);
+
+    /**
+     * \brief Transforms a distributed matrix to a numpy array of shape
+     *        (rows, cols) on every process.
      *
      * @return Numpy Array.
      */
-    py::array_t<T> gather();
+    py::array_t<T> gatherAll();
+
+    /**
+     * \brief Collects the rows \em r0 <= r < \em r1 and columns \em c0 <= c < \em c1
+     *        in a numpy array of shape (r1 - r0, c1 - c0) on process \em root.
+     *        Each process only sends the elements of the region it stores; the
+     *        other processes return None.
+     *
+     * @param r0 The first row.
+     * @param r1 The row after the last one.
+     * @param c0 The first column.
+     * @param c1 The column after the last one.
+     * @param root The process receiving the region.
+     * @return Numpy Array on \em root, None elsewhere.
+     */
+    py::object gatherRegion(int r0, int r1, int c0, int c1, int root = 0);
 
 
     //
@@ -157,11 +603,15 @@ public:
     int getCols();
 
     /**
-    * \brief Returns the local partition.
+    * \brief Returns a writable NumPy array viewing the local partition without
+    *        copying it. The array keeps the distributed matrix alive and reflects
+    *        all later changes made by skeletons applied in place. If the local
+    *        partition consists of whole rows, the array has the shape
+    *        (rows, cols), otherwise it is one-dimensional.
     *
     * @return The local partition.
     */
-    T* getLocalPartition();
+    py::array_t<T> getLocalPartition();
 
     /**
     * \briefs Sets the local partition.
@@ -170,6 +620,26 @@ public:
     */
     void setLocalPartition(py::array_t<T> array);
 
+    /**
+    * \brief Uses the memory of \em array as the local partition without copying
+    *        it. The array must be C-contiguous, writable, aligned and have exactly
+    *        getLocalSize() elements; otherwise it is copied. Changes of the array are
+    *        visible in the distributed matrix and vice versa.
+    *
+    * @param array Numpy Array.
+    */
+    void adoptLocalPartition(py::array_t<T> array);
+
+    /**
+    * \brief Moves the local partition to memory backed by \em pages (see
+    *        msl::setHugePages()). Copies and results of skeletons of this
+    *        distributed matrix use the same pages. Existing NumPy views and
+    *        the file of a memory-mapped partition are no longer connected to it.
+    *
+    * @param pages The kind of pages.
+    */
+    void setHugePages(HugePages pages);
+
     /**
     * \briefs Sets the local partition.
     *
@@ -177,13 +647,47 @@ public:
     */
     void setMatrix(py::array_t<T> array);
 
+    /**
+    * \brief Sets the distributed matrix to \em array, which only process
+    *        \em root needs to hold. Each process receives just its local
+    *        partition. The other processes may pass None.
+    *
+    * @param root The process holding the array.
+    * @param array Numpy Array with at least getSize() elements in row-major
+    *        order (on \em root).
+    */
+    void scatterFrom(int root, py::object array);
+
     /**
     * \brief Returns the element at the given global index \em index.
     *
     * @param index The global index.
     * @return The element at the given global index.
     */
-    T get(int index) const;
+    T get(long index);
+
+    /**
+    * \brief Returns the elements at the global indices \em indices as an array of
+    *        the same shape. Unlike get(), the processes may request different
+    *        indices, but all of them must call this method. The requests are
+    *        exchanged in one all-to-all round, so reading any number of elements
+    *        takes a constant number of collective operations.
+    *
+    * @param indices The global indices.
+    * @return The elements.
+    */
+    py::array_t<T> getMany(py::array_t<long, py::array::c_style | py::array::forcecast> indices);
+
+    /**
+    * \brief Returns the elements with the global indices \em start <= i < \em stop.
+    *        The processes may request different ranges, but all of them must call
+    *        this method (see getMany()).
+    *
+    * @param start The first global index.
+    * @param stop The global index after the last one.
+    * @return The elements.
+    */
+    py::array_t<T> getRange(long start, long stop);
 
     /**
     * \brief Sets the element at the given global index \em globalIndex to the
@@ -192,14 +696,51 @@ public:
     * @param globalIndex The global index.
     * @param v The new value.
     */
-    void set(int globalIndex, const T& v);
+    void set(long globalIndex, const T& v);
+
+    /**
+    * \brief Returns the element at the global index \em index by reading it
+    *        directly from the local partition of its owner. Unlike get(), only
+    *        the calling process takes part. Remote accesses see the state of the
+    *        local partitions after the last skeleton (pending lazy maps are not
+    *        applied) and must be separated from skeletons and local accesses by
+    *        a collective operation such as msl::barrier(). The matrix must have
+    *        been created (or copied) in the same order relative to other
+    *        containers on all processes, otherwise the access is reported.
+    *
+    * @param index The global index.
+    * @return The element at the given global index.
+    */
+    T remoteGet(long index);
+
+    /**
+    * \brief Sets the element at the global index \em index to \em v by writing it
+    *        directly to the local partition of its owner (see remoteGet()).
+    *        Copies sharing that local partition see the new value as well.
+    *
+    * @param index The global index.
+    * @param v The new value.
+    */
+    void remotePut(long index, const T& v);
+
+    /**
+    * \brief Combines the element at the global index \em index with \em v using
+    *        \em op (ADD, MUL, MIN or MAX) in the local partition of its owner
+    *        (see remotePut()). Concurrent accumulations to the same element with
+    *        the same operator are atomic.
+    *
+    * @param index The global index.
+    * @param v The operand.
+    * @param op The operator.
+    */
+    void accumulate(long index, const T& v, Operator op = Operator::ADD);
 
     /**
     * \brief Returns the global size of the distributed matrix.
     *
     * @return The global size.
     */
-    int getSize() const;
+    long getSize() const;
 
     /**
     * \brief Returns the size of local partitions of the distributed matrix.
@@ -213,7 +754,7 @@ public:
     *
     * @return The first (global) index.
     */
-    int getFirstIndex() const;
+    long getFirstIndex() const;
 
     /**
     * \brief Checks whether the element at the given global index \em index is
@@ -222,7 +763,7 @@ public:
     * @param index The global index.
     * @return True if the element is locally stored.
     */
-    bool isLocal(int index) const;
+    bool isLocal(long index) const;
 
     /**
     * \brief Returns the element at the given local index \em index. Note that
@@ -260,16 +801,29 @@ public:
     void printLocal();
 
 private:
+    // conversions (mapCast) access other element types
+    template <typename> friend class DM;
+
     //
     // Attributes
     //
 
-    // local partition
+    // local partition (shared with copies until either of them is written)
     T* localPartition;
+    // owner of the local partition
+    std::shared_ptr<T> buffer;
+    // number of NumPy views of the local partition (see getLocalPartition)
+    int views;
+    // pages backing the local partition
+    HugePages pages;
+    // maps and zips not yet applied to the local partition
+    detail::Pipeline<T> pipeline;
+    // local partition as accessed by the one-sided operations of other processes
+    detail::RemotePartition<T> remote;
     // position of processor in data parallel group of processors; zero-base
     int id;
     // Number of elements
-    int n;
+    long n;
     // Number of cols
     int ncol;
     // Number of rows
@@ -277,7 +831,7 @@ private:
     // Number of local elements
     int nLocal;
     // First (global) index of local partition
-    int firstIndex;
+    long firstIndex;
     // First (global) row in local partition
     int firstRow;
     // Total number of MPI processes
@@ -289,8 +843,40 @@ private:
     // AUXILIARY
     //
 
-    // initializes distributed matrix (used in constructors).
-    void init();
+    // initializes distributed matrix (used in constructors); allocates the local
+    // partition unless allocateLocal is false.
+    void init(bool allocateLocal = true);
+    // first global index of the local partition of each process, followed by the
+    // global index after the last local partition.
+    std::vector<long> partitionBounds() const;
+    // allocates a new local partition.
+    void allocate();
+    // maps the local partition from a file (see the constructor).
+    void attach(const std::string& path, bool perRank);
+    // leaves the container without elements after it has been moved from.
+    void abandon();
+    // checks whether the local partition is shared with a copy (views do not count).
+    bool isShared() const;
+    // creates a NumPy view of the local partition with the given shape.
+    py::array_t<T> localView(const std::vector<py::ssize_t>& shape);
+    // evaluates and detaches the local partition from copies before it is modified.
+    void prepareWrite();
+    // drops pending maps and detaches the local partition before it is overwritten.
+    void prepareOverwrite();
+    // evaluates the pending maps unless lazy evaluation is switched on.
+    void finishMap();
+    // makes out a copy of this matrix that reuses the local partition of out. Returns
+    // false if the dimensions differ.
+    bool prepareDestination(DM<T>& out);
+    // applies stage to chunks of rows handed out dynamically to all processes.
+    void mapDynamic(const typename detail::Pipeline<T>::Stage& stage);
+    // number of elements of the region [r0, r1) x [c0, c1) in row-major order that
+    // precede the given global index.
+    long regionOffset(long index, int r0, int r1, int c0, int c1) const;
+    // process storing the element with the given global index.
+    int ownerOf(long index) const;
+    // first global index of the local partition of process rank.
+    long firstIndexOf(int rank) const;
 };
 }
 
@@ -0,0 +1,162 @@
+/*
+ * expression.h
+ *
+ * Arithmetic expressions as user functions of the map skeletons. An expression
+ * such as "x * 10 + i" is parsed once into register-based bytecode, which is
+ * then evaluated over the local partition in blocks of elements.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace msl {
+
+/**
+ * \brief Class Expression represents a compiled arithmetic expression.
+ *
+ * Expressions consist of numbers, variables, the operators + - * / % ** (power),
+ * comparisons (< <= > >= == !=), logical operators (&& || !), the conditional
+ * operator c ? a : b, parentheses and the functions abs, sqrt, exp, log, sin,
+ * cos, tan, floor, ceil, min, max, pow and where(c, a, b). Comparisons and
+ * logical operators yield 1 or 0. All values are computed in double precision.
+ */
+class Expression
+{
+public:
+  /**
+   * \brief Number of elements evaluated per instruction.
+   */
+  static const int BLOCK = 256;
+
+  /**
+   * \brief Compiles \em source. Syntax errors are reported and yield an
+   *        invalid expression.
+   *
+   * @param source The expression.
+   * @param variables Names of the variables that may appear in the expression.
+   */
+  Expression(const std::string& source, const std::vector<std::string>& variables);
+
+  /**
+   * \brief Checks whether the expression was compiled successfully.
+   */
+  bool isValid() const;
+
+  /**
+   * \brief Checks whether the variable with index \em variable is used.
+   */
+  bool uses(int variable) const;
+
+  /**
+   * \brief Returns the number of doubles of workspace needed by evaluate().
+   */
+  size_t workspaceSize() const;
+
+  /**
+   * \brief Evaluates the expression for \em count <= BLOCK elements.
+   *
+   * @param inputs One array of \em count values per variable (unused
+   *        variables may be nullptr).
+   * @param out Result array of \em count values.
+   * @param count Number of elements.
+   * @param workspace Workspace of workspaceSize() doubles.
+   */
+  void evaluate(const double* const* inputs, double* out, int count, double* workspace) const;
+
+  // Opcodes of the bytecode.
+  enum OpCode {
+    ADD, SUB, MUL, DIV, MOD, POW, MIN, MAX,
+    LT, LE, GT, GE, EQ, NE, AND, OR,
+    NEG, NOT, ABS, SQRT, EXP, LOG, SIN, COS, TAN, FLOOR, CEIL,
+    SELECT
+  };
+
+  // One instruction: registers[dst] = op(registers[a], registers[b], registers[c]).
+  struct Instruction {
+    OpCode op;
+    int dst, a, b, c;
+  };
+
+private:
+  class Parser;
+
+  // number of variables; registers [0, numVariables) hold their values
+  int numVariables;
+  // values of the constant registers [numVariables, numVariables + constants.size())
+  std::vector<double> constants;
+  // number of temporary registers following the constant registers
+  int numTemporaries;
+  // register holding the result
+  int result;
+  std::vector<Instruction> code;
+  std::vector<bool> used;
+  bool valid;
+};
+
+/**
+ * \brief Evaluates \em e for \em count elements of a local partition starting at
+ *        global index \em firstIndex. The variables are x (the element), i (its
+ *        global index) and, if \em ncol > 0, row and col (its position in a
+ *        matrix with \em ncol columns), in this order.
+ *
+ * @param e The expression.
+ * @param in Input elements.
+ * @param out Output elements; may be the same as \em in.
+ * @param count Number of elements.
+ * @param firstIndex Global index of the first element.
+ * @param ncol Number of columns, or 0 for distributed arrays.
+ */
+template <typename T>
+void evaluateExpression(const Expression& e, const T* in, T* out, int count, long firstIndex, int ncol)
+{
+  std::vector<double> buffers(5 * Expression::BLOCK);
+  std::vector<double> workspace(e.workspaceSize());
+  double* x = &buffers[0];
+  double* i = x + Expression::BLOCK;
+  double* row = i + Expression::BLOCK;
+  double* col = row + Expression::BLOCK;
+  double* result = col + Expression::BLOCK;
+  const double* inputs[] = {x, i, row, col};
+
+  for (int k = 0; k < count; k += Expression::BLOCK) {
+    int n = count - k < Expression::BLOCK ? count - k : Expression::BLOCK;
+    for (int j = 0; j < n; j++) {
+      x[j] = (double) in[k + j];
+    }
+    if (e.uses(1)) {
+      for (int j = 0; j < n; j++) {
+        i[j] = firstIndex + k + j;
+      }
+    }
+    if (ncol > 0 && (e.uses(2) || e.uses(3))) {
+      for (int j = 0; j < n; j++) {
+        row[j] = (firstIndex + k + j) / ncol;
+        col[j] = (firstIndex + k + j) % ncol;
+      }
+    }
+    e.evaluate(inputs, result, n, workspace.data());
+    for (int j = 0; j < n; j++) {
+      out[k + j] = static_cast<T>(result[j]);
+    }
+  }
+}
+
+/**
+ * \brief Variable names of expressions over distributed arrays.
+ */
+inline std::vector<std::string> arrayVariables()
+{
+  return {"x", "i"};
+}
+
+/**
+ * \brief Variable names of expressions over distributed matrices.
+ */
+inline std::vector<std::string> matrixVariables()
+{
+  return {"x", "i", "row", "col"};
+}
+
+}
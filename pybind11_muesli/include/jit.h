@@ -0,0 +1,141 @@
+/*
+ * jit.h
+ *
+ * User functions written in C++ and compiled at runtime. The kernel source is
+ * compiled with the system compiler into a shared object, which is cached on
+ * disk under a hash of its content and loaded with dlopen.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "pixel.h"
+
+namespace msl {
+
+/**
+ * \brief Name and definition of an element type inside generated kernel
+ *        source. Must be layout compatible with the type on the host.
+ */
+template <typename T> struct KernelType;
+template <> struct KernelType<std::int8_t> {
+  static const char* name() { return "signed char"; }
+  static const char* definition() { return ""; }
+};
+template <> struct KernelType<std::int16_t> {
+  static const char* name() { return "short"; }
+  static const char* definition() { return ""; }
+};
+template <> struct KernelType<int> {
+  static const char* name() { return "int"; }
+  static const char* definition() { return ""; }
+};
+template <> struct KernelType<std::int64_t> {
+  static const char* name() { return "long"; }
+  static const char* definition() { return ""; }
+};
+template <> struct KernelType<std::uint8_t> {
+  static const char* name() { return "unsigned char"; }
+  static const char* definition() { return ""; }
+};
+template <> struct KernelType<std::uint16_t> {
+  static const char* name() { return "unsigned short"; }
+  static const char* definition() { return ""; }
+};
+template <> struct KernelType<std::uint32_t> {
+  static const char* name() { return "unsigned int"; }
+  static const char* definition() { return ""; }
+};
+template <> struct KernelType<std::uint64_t> {
+  static const char* name() { return "unsigned long"; }
+  static const char* definition() { return ""; }
+};
+template <> struct KernelType<float> {
+  static const char* name() { return "float"; }
+  static const char* definition() { return ""; }
+};
+template <> struct KernelType<double> {
+  static const char* name() { return "double"; }
+  static const char* definition() { return ""; }
+};
+template <> struct KernelType<Pixel> {
+  static const char* name() { return "Pixel"; }
+  static const char* definition() { return "struct Pixel { unsigned char r, g, b; };\n"; }
+};
+
+/**
+ * \brief Class Kernel represents a user function compiled at runtime.
+ *
+ * The user supplies the body of the function
+ *
+ *   T f(long i, long row, long col, T x, const double* p)
+ *
+ * where x is the element, i its global index, row and col its position (row is
+ * 0 and col equals i for distributed arrays) and p the parameters passed to the
+ * skeleton. The body is wrapped in a loop over the local partition and
+ * compiled with "$MUESLI_CXX" (default "c++") and -O3 -march=native, so the
+ * compiler can inline and vectorize it. Compiled kernels are stored in
+ * "$MUESLI_KERNEL_CACHE" (default "~/.cache/muesli/kernels") under a hash of
+ * their source, the compiler and the host CPU, and reused by later runs. Since
+ * -march=native code may not run on other CPUs, nodes of different types that
+ * share the cache compile their own kernels. On each node, the first process
+ * compiles a missing kernel while the others wait.
+ *
+ * Constructing a kernel is a collective operation.
+ */
+class Kernel
+{
+public:
+  /**
+   * \brief Compiles (or loads from the cache) the kernel with the given body
+   *        for element type \em T. Compilation errors are reported and yield an
+   *        invalid kernel.
+   *
+   * @param body Body of the user function.
+   * @tparam T Element type.
+   */
+  template <typename T>
+  static Kernel create(const std::string& body)
+  {
+    return Kernel(body, KernelType<T>::name(), KernelType<T>::definition());
+  }
+
+  /**
+   * \brief Checks whether the kernel was compiled and loaded successfully.
+   */
+  bool isValid() const;
+
+  /**
+   * \brief Applies the kernel to \em count elements starting at global index
+   *        \em firstIndex.
+   *
+   * @param in Input elements.
+   * @param out Output elements; may be the same as \em in.
+   * @param count Number of elements.
+   * @param firstIndex Global index of the first element.
+   * @param ncol Number of columns, or 0 for distributed arrays.
+   * @param params Parameters passed to the user function as p.
+   */
+  template <typename T>
+  void run(const T* in, T* out, int count, long firstIndex, int ncol, const std::vector<double>& params) const
+  {
+    function(in, out, count, firstIndex, ncol, params.data());
+  }
+
+private:
+  typedef void (*Function)(const void* in, void* out, long count, long firstIndex, long ncol, const double* p);
+
+  Kernel(const std::string& body, const std::string& typeName, const std::string& typeDefinition);
+
+  Function function;
+};
+
+/**
+ * \brief Returns the directory of the kernel cache.
+ */
+std::string getKernelCacheDirectory();
+
+}
@@ -1,7 +1,6 @@
 #pragma once
 
 #include <mpi.h>
-#include <openacc.h>
 
 #include <pybind11/pybind11.h>
 #include <iostream>
@@ -15,6 +14,8 @@
 #include <math.h>
 
 #include "detail/exception.h"
+#include "detail/message.h"
+#include "detail/pool.h"
 #include "timer.h"
 
 #define MSL_USERFUNC
@@ -43,6 +44,10 @@ public:
   static int num_conc_kernels;          // number of concurrent kernels (farm skeleton)
   static int num_runs;                  // number of runs, for benchmarking
   static int num_gpus;                // number of GPUs
+  static int batch_size;                // number of elements per call of a batch function
+  static bool lazy_evaluation;          // defer maps until the data is needed?
+  static int num_threads;               // number of threads per process
+  static HugePages huge_pages;          // pages backing new local partitions
   static bool debug_communication;      // farm skeleton
   static bool use_timer;                // use a timer?
   static bool farm_statistics;          // collect statistics of how many task were processed by CPU/GPU
@@ -61,11 +66,33 @@ static const int DEFAULT_TASK_GROUP_SIZE = 256;
 static const int DEFAULT_NUM_CONC_KERNELS = 16;
 static const int DEFAULT_NUM_RUNS = 1;
 static const int DEFAULT_TILE_WIDTH = 16;
+static const int DEFAULT_BATCH_SIZE = 65536;
+static const int DEFAULT_CHUNKS_PER_PROC = 16; // chunks of dynamically balanced maps
+
+/**
+ * \brief Placement of the threads of the processes on the cores of a node.
+ */
+enum class Pinning {
+  NONE,    // left to the operating system
+  THREADS, // each thread pinned to one of the cores the process may run on
+  RANKS    // cores of a node split among its processes, threads pinned within the share
+};
 
 /**
  * \brief Initializes Muesli. Needs to be called before any skeleton is used.
+ *
+ * @param debug_communication Debug the communication of the farm skeleton?
+ * @param num_threads Number of threads per process used by the skeletons with
+ *        native user functions. A value <= 0 divides the cores of a node evenly
+ *        among the processes running on it.
+ * @param pinning Placement of the threads. Pinned threads are ordered by NUMA
+ *        node, so that local partitions are split into one part per NUMA node
+ *        (see pinThreads()). Pinning::THREADS relies on the binding of the
+ *        processes by mpirun, Pinning::RANKS binds them itself.
+ * @param huge_pages Pages backing local partitions (see setHugePages()).
  */
-void initSkeletons(bool debug_communication = 0);
+void initSkeletons(bool debug_communication = 0, int num_threads = 0, Pinning pinning = Pinning::NONE,
+                   HugePages huge_pages = HugePages::NONE);
 
 /**
  * \brief Terminates Muesli. Needs to be called at the end of a Muesli application.
@@ -97,6 +124,70 @@ void setNumRuns(int num_runs);
  */
 void setTaskGroupSize(int size);
 
+/**
+ * \brief Sets the number of elements passed to a batch function (mapBatch,
+ *        mapIndexBatch, ...) per call. A value <= 0 passes the whole local
+ *        partition at once.
+ *
+ * @param size The batch size.
+ */
+void setBatchSize(int size);
+
+/**
+ * \brief Gets the number of elements passed to a batch function per call.
+ */
+int getBatchSize();
+
+/**
+ * \brief Sets the number of threads per process. Python user functions are
+ *        always called by a single thread.
+ *
+ * @param num_threads The number of threads.
+ */
+void setNumThreads(int num_threads);
+
+/**
+ * \brief Gets the number of threads per process.
+ */
+int getNumThreads();
+
+/**
+ * \brief Sets the pages backing the local partitions of containers created
+ *        afterwards. Huge pages reduce the TLB misses of strided traversals of
+ *        large partitions. If the requested pages are not available, smaller ones
+ *        are used. Single containers may deviate (see DA::setHugePages()).
+ *
+ * @param pages The kind of pages.
+ */
+void setHugePages(HugePages pages);
+
+/**
+ * \brief Gets the pages backing the local partitions of new containers.
+ */
+HugePages getHugePages();
+
+/**
+ * \brief Switches lazy evaluation on or off. If on, maps, zips and their
+ *        variants only record the user function. The recorded functions of a
+ *        container are fused into a single traversal of its local partition
+ *        when its data is needed (e.g. by gather, get or show) or when
+ *        evaluate() is called.
+ *
+ * @param val True to defer maps.
+ */
+void setLazyEvaluation(bool val);
+
+/**
+ * \brief Checks whether lazy evaluation is switched on.
+ */
+bool getLazyEvaluation();
+
+/**
+ * \brief Frees the memory of released local partitions, which is otherwise
+ *        kept for reuse by containers of the same size.
+ */
+void clearPartitionPool();
+
 /**
  * \brief Starts timing
  */
@@ -153,6 +244,8 @@ inline void MSL_ReceiveTag(int source, int tag);
 //
 // SEND/RECV FOR DATA PARALLEL SKELETONS
 //
+// Sizes are numbers of elements of type T. Messages of more than INT_MAX bytes
+// are described by a derived datatype (see detail::Message).
 
 /**
  * \brief Sends a buffer of type \em T to process \em destination.
@@ -267,7 +360,34 @@ void allgather(T* send_buffer, T* recv_buffer, int* const ids, int np, size_t co
  * @tparam T Type of the message.
  */
 template<typename T>
-void allgather(T* send_buffer, T* recv_buffer, int count);
+void allgather(T* send_buffer, T* recv_buffer, size_t count);
+
+/**
+ * \brief Wrapper for the MPI_Gatherv routine. Every process in \em MPI_COMM WORLD
+ *        participates. Process p sends the elements bounds[p] <= i < bounds[p + 1]
+ *        of \em recv_buffer, which is only used by \em root. Beyond INT_MAX
+ *        elements, the root receives the contributions one by one.
+ *
+ * @param send_buffer Send buffer.
+ * @param recv_buffer Receive buffer.
+ * @param bounds The bounds of the contributions (number of processes + 1).
+ * @param root Root process id of the gather.
+ * @tparam T Type of the message.
+ */
+template<typename T>
+void gatherv(const T* send_buffer, T* recv_buffer, const long* bounds, int root);
+
+/**
+ * \brief Wrapper for the MPI_Allgatherv routine. Every process in \em MPI_COMM WORLD
+ *        participates and receives all contributions (see gatherv()).
+ *
+ * @param send_buffer Send buffer.
+ * @param recv_buffer Receive buffer.
+ * @param bounds The bounds of the contributions (number of processes + 1).
+ * @tparam T Type of the message.
+ */
+template<typename T>
+void allgatherv(const T* send_buffer, T* recv_buffer, const long* bounds);
 
 /**
  * \brief Wrapper for the MPI_Scatter routine. Every process in \em MPI_COMM WORLD
@@ -281,6 +401,50 @@ void allgather(T* send_buffer, T* recv_buffer, int count);
 template<typename T>
 void scatter(T* send_buffer, T* recv_buffer, size_t count);
 
+/**
+ * \brief Wrapper for the MPI_Scatterv routine. Every process in \em MPI_COMM WORLD
+ *        participates. Process p receives the elements bounds[p] <= i < bounds[p + 1]
+ *        of \em send_buffer, which is only used by \em root. Beyond INT_MAX
+ *        elements, the root sends the parts one by one.
+ *
+ * @param send_buffer Send buffer.
+ * @param recv_buffer Receive buffer.
+ * @param bounds The bounds of the parts (number of processes + 1).
+ * @param root Root process id of the scatter.
+ * @tparam T Type of the message.
+ */
+template<typename T>
+void scatterv(const T* send_buffer, T* recv_buffer, const long* bounds, int root);
+
+/**
+ * \brief Wrapper for the MPI_Alltoall routine. Every process in \em MPI_COMM WORLD
+ *        participates and sends \em count elements to each process.
+ *
+ * @param send_buffer Send buffer.
+ * @param recv_buffer Receive buffer.
+ * @param count Number of elements sent to each process.
+ * @tparam T Type of the message.
+ */
+template<typename T>
+void alltoall(T* send_buffer, T* recv_buffer, int count);
+
+/**
+ * \brief Wrapper for the MPI_Alltoallv routine. Every process in \em MPI_COMM WORLD
+ *        participates. Counts and displacements are given in elements; the
+ *        regions sent to different processes may overlap.
+ *
+ * @param send_buffer Send buffer.
+ * @param send_counts Number of elements sent to each process.
+ * @param send_displs Offset of the elements sent to each process.
+ * @param recv_buffer Receive buffer.
+ * @param recv_counts Number of elements received from each process.
+ * @param recv_displs Offset of the elements received from each process.
+ * @tparam T Type of the message.
+ */
+template<typename T>
+void alltoallv(const T* send_buffer, const int* send_counts, const int* send_displs,
+               T* recv_buffer, const int* recv_counts, const int* recv_displs);
+
 /**
  * \brief Wrapper for the MPI_Broadcast routine. Every process in \em MPI_COMM WORLD
  *        participates.
@@ -291,7 +455,7 @@ void scatter(T* send_buffer, T* recv_buffer, size_t count);
  * @tparam T Type of the message.
  */
 template <typename T>
-inline void MSL_Broadcast(int source, T* buffer, int size);
+inline void MSL_Broadcast(int source, T* buffer, size_t size);
 
 /**
  * \brief Wrapper for the MPI_Barrier routine. Every process in \em MPI_COMM WORLD
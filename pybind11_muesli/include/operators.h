@@ -0,0 +1,186 @@
+/*
+ * operators.h
+ *
+ * Native element-wise operators for the map skeletons of DA and DM. They run
+ * over a local partition without calling back into Python.
+ */
+
+#pragma once
+
+#include <string>
+#include <type_traits>
+#include <pybind11/pybind11.h>
+#include "muesli.h"
+
+namespace py = pybind11;
+
+namespace msl {
+
+/**
+ * \brief Element-wise operators. Unless stated otherwise, \em a and \em b denote
+ *        the scalar operands passed together with the operator.
+ */
+enum class Operator {
+  IDENTITY, // x
+  ADD,      // x + a
+  SUB,      // x - a
+  MUL,      // x * a
+  DIV,      // x / a
+  AFFINE,   // a * x + b
+  CLAMP,    // min(max(x, a), b)
+  ABS,      // |x|
+  NEG,      // -x
+  MIN,      // min(x, a)
+  MAX,      // max(x, a)
+  EQ,       // x == a (1 or 0)
+  NE,       // x != a (1 or 0)
+  LT,       // x < a  (1 or 0)
+  LE,       // x <= a (1 or 0)
+  GT,       // x > a  (1 or 0)
+  GE        // x >= a (1 or 0)
+};
+
+/**
+ * \brief Looks up the operator with the given name, e.g. "mul" or "*". Unknown
+ *        names are reported and leave \em op unchanged.
+ *
+ * @param name The name of the operator.
+ * @param op The operator.
+ * @return False if the name is unknown.
+ */
+bool parseOperator(const std::string& name, Operator& op);
+
+namespace detail {
+
+template <typename T, typename F>
+inline void elementwise(const T* in, T* out, int count, F f)
+{
+  for (int k = 0; k < count; k++) {
+    out[k] = f(in[k]);
+  }
+}
+
+}
+
+/**
+ * \brief Applies \em op to \em count elements of \em in and writes the results
+ *        to \em out. \em in and \em out may be the same buffer. The loop for
+ *        each operator is free of calls and branches so that the compiler can
+ *        vectorize it.
+ *
+ * @param op The operator.
+ * @param in Input elements.
+ * @param out Output elements.
+ * @param count Number of elements.
+ * @param a First scalar operand.
+ * @param b Second scalar operand.
+ */
+template <typename T>
+void applyOperator(Operator op, const T* in, T* out, int count, T a, T b)
+{
+  switch (op) {
+  case Operator::IDENTITY:
+    detail::elementwise(in, out, count, [](T x) { return x; });
+    break;
+  case Operator::ADD:
+    detail::elementwise(in, out, count, [a](T x) { return T(x + a); });
+    break;
+  case Operator::SUB:
+    detail::elementwise(in, out, count, [a](T x) { return T(x - a); });
+    break;
+  case Operator::MUL:
+    detail::elementwise(in, out, count, [a](T x) { return T(x * a); });
+    break;
+  case Operator::DIV:
+    detail::elementwise(in, out, count, [a](T x) { return T(x / a); });
+    break;
+  case Operator::AFFINE:
+    detail::elementwise(in, out, count, [a, b](T x) { return T(a * x + b); });
+    break;
+  case Operator::CLAMP:
+    detail::elementwise(in, out, count, [a, b](T x) { return x < a ? a : (x > b ? b : x); });
+    break;
+  case Operator::ABS:
+    detail::elementwise(in, out, count, [](T x) { return x < T(0) ? T(-x) : x; });
+    break;
+  case Operator::NEG:
+    detail::elementwise(in, out, count, [](T x) { return T(-x); });
+    break;
+  case Operator::MIN:
+    detail::elementwise(in, out, count, [a](T x) { return x < a ? x : a; });
+    break;
+  case Operator::MAX:
+    detail::elementwise(in, out, count, [a](T x) { return x > a ? x : a; });
+    break;
+  case Operator::EQ:
+    detail::elementwise(in, out, count, [a](T x) { return T(x == a); });
+    break;
+  case Operator::NE:
+    detail::elementwise(in, out, count, [a](T x) { return T(x != a); });
+    break;
+  case Operator::LT:
+    detail::elementwise(in, out, count, [a](T x) { return T(x < a); });
+    break;
+  case Operator::LE:
+    detail::elementwise(in, out, count, [a](T x) { return T(x <= a); });
+    break;
+  case Operator::GT:
+    detail::elementwise(in, out, count, [a](T x) { return T(x > a); });
+    break;
+  case Operator::GE:
+    detail::elementwise(in, out, count, [a](T x) { return T(x >= a); });
+    break;
+  }
+}
+
+/**
+ * \brief Checks whether \em op can be applied with the operands \em a and \em b.
+ *        Reports and returns false for an integer division by zero.
+ */
+template <typename T>
+bool checkOperator(Operator op, T a, T b)
+{
+  if (op == Operator::DIV && std::is_integral<T>::value && a == T(0)) {
+    throws(detail::DivisionByZeroException());
+    return false;
+  }
+  return true;
+}
+
+/**
+ * \brief Returns the MPI reduction performing \em op for the remote accumulation
+ *        of elements of type T (see DA::accumulate()). Operators without one are
+ *        reported and yield MPI_OP_NULL.
+ */
+template <typename T>
+MPI_Op accumulation(Operator op)
+{
+  switch (op) {
+  case Operator::ADD:
+    return MPI_SUM;
+  case Operator::MUL:
+    return MPI_PROD;
+  case Operator::MIN:
+    if (std::is_arithmetic<T>::value) {
+      return MPI_MIN;
+    }
+    break;
+  case Operator::MAX:
+    if (std::is_arithmetic<T>::value) {
+      return MPI_MAX;
+    }
+    break;
+  default:
+    break;
+  }
+  throws(detail::UnknownOperatorException("no remote accumulation for this operator and element type"));
+  return MPI_OP_NULL;
+}
+
+}
+
+//
+// BINDING FUNCTION
+//
+
+void bind_operators(py::module& m);
@@ -1,3 +1,5 @@
+#pragma once
+
 struct Pixel
 {
     unsigned char r, g, b;
@@ -0,0 +1,228 @@
+/*
+ * soadm.h
+ *
+ * Distributed matrices of structs stored as structure of arrays: each field of
+ * the element type lives in its own contiguous plane, so per-field kernels and
+ * the export of single fields (e.g. the channels of an image) stream
+ * contiguous memory instead of striding over interleaved structs.
+ */
+
+#pragma once
+
+#include <array>
+#include <memory>
+#include <string>
+#include "muesli.h"
+#include "pixel.h"
+#include "jit.h"
+#include "detail/exception.h"
+#include "detail/cfunction.h"
+#include "detail/partition.h"
+#include "detail/pipeline.h"
+#include "detail/pool.h"
+#include "threadpool.h"
+#include <pybind11/pybind11.h>
+#include <pybind11/functional.h>
+#include <pybind11/numpy.h>
+
+namespace py = pybind11;
+
+namespace msl {
+
+/**
+ * \brief Layout of an element type stored as structure of arrays. Specializations
+ *        name the fields, which must all be of type Field, and convert between an
+ *        element and its fields at position k of the planes.
+ */
+template <typename T> struct SoATraits;
+template <> struct SoATraits<Pixel> {
+    typedef unsigned char Field;
+    static const int fields = 3;
+    static const char* name(int field)
+    {
+        static const char* names[] = {"r", "g", "b"};
+        return names[field];
+    }
+    static Pixel load(Field* const* planes, int k)
+    {
+        Pixel p;
+        p.r = planes[0][k];
+        p.g = planes[1][k];
+        p.b = planes[2][k];
+        return p;
+    }
+    static void store(const Pixel& p, Field* const* planes, int k)
+    {
+        planes[0][k] = p.r;
+        planes[1][k] = p.g;
+        planes[2][k] = p.b;
+    }
+};
+
+/**
+ * \brief Class SoADM represents a distributed matrix whose elements are stored
+ *        as structure of arrays (see SoATraits).
+ *
+ * The matrix is distributed like a DM. Its elements are passed to and returned
+ * from user functions as structs; the fields of the local partition are
+ * exposed as contiguous NumPy planes by getPlane.
+ *
+ * \tparam T Element type with a specialization of SoATraits.
+ */
+template <typename T>
+class SoADM
+{
+public:
+    typedef typename SoATraits<T>::Field Field;
+    static const int FIELDS = SoATraits<T>::fields;
+
+    //
+    // CONSTRUCTORS / DESTRUCTOR
+    //
+
+    /**
+    * \brief Creates an empty distributed matrix.
+    *
+    * @param row amount of rows of the distributed matrix.
+    * @param col amount of columns of the distributed matrix.
+    */
+    SoADM(int row, int col);
+
+    /**
+    * \brief Creates a distributed matrix with \em row * \em col elements equal to
+    *        \em initial_value.
+    *
+    * @param row amount of rows of the distributed matrix.
+    * @param col amount of columns of the distributed matrix.
+    * @param initial_value Initial value for all elements.
+    */
+    SoADM(int row, int col, const T& initial_value);
+
+    SoADM(const SoADM<T>& other) = delete;
+    SoADM(SoADM<T>&& other) = default;
+    SoADM<T>& operator=(const SoADM<T>& other) = delete;
+    SoADM<T>& operator=(SoADM<T>&& other) = default;
+
+    /**
+    * \brief Initializes the elements of the distributed matrix with the value \em
+    *        value.
+    *
+    * @param value The value.
+    */
+    void fill(const T& value);
+
+    //
+    // SKELETONS / COMPUTATION / MAP
+    //
+
+    /**
+    * \brief Replaces each element a[i] of the distributed matrix with f(row, column, a[i]).
+    *        Pixels cannot be passed to ctypes or numba functions; native code is
+    *        supplied as a compiled kernel instead (see mapInPlaceKernel).
+    *
+    * @param f Python function.
+    */
+    void mapIndexInPlaceM(const std::function<T(int,int,T)> &f);
+
+    /**
+    * \brief Replaces each element with the result of a user function written in C++
+    *        and compiled at runtime (see DM::mapInPlaceKernel).
+    *
+    * @param body Body of the user function.
+    * @param params Parameters passed to the user function as p.
+    */
+    void mapInPlaceKernel(const std::string& body, const std::vector<double>& params = std::vector<double>());
+
+    //
+    // GETTERS AND SETTERS
+    //
+
+    /**
+    * \brief Returns the element at the given global index \em index.
+    *
+    * @param index The global index.
+    * @return The element at the given global index.
+    */
+    T get(long index) const;
+
+    /**
+    * \brief Returns the field \em field of the local partition as a NumPy array of
+    *        shape (local rows, columns) that shares memory with this matrix.
+    *
+    * @param field Index of the field.
+    */
+    py::array_t<Field> getPlane(int field);
+
+    /**
+    * \brief Same as getPlane, but selects the field by name.
+    *
+    * @param field Name of the field, e.g. "r" for Pixel.
+    */
+    py::array_t<Field> getPlane(const std::string& field);
+
+    /**
+    * \brief Returns the field \em field of the whole matrix on every process as a
+    *        NumPy array of shape (rows, columns).
+    *
+    * @param field Index of the field.
+    */
+    py::array_t<Field> gatherPlane(int field) const;
+
+    /**
+    * \brief Returns the whole matrix on every process as a NumPy array of shape
+    *        (rows, columns, fields), e.g. an RGB image for Pixel.
+    */
+    py::array_t<Field> gather() const;
+
+    int getRows() const;
+
+    int getCols() const;
+
+    long getSize() const;
+
+    int getLocalSize() const;
+
+    long getFirstIndex() const;
+
+private:
+    //
+    // Attributes
+    //
+
+    // memory of all planes
+    std::shared_ptr<Field> buffer;
+    // start of the local part of each field
+    std::array<Field*, FIELDS> planes;
+    // position of processor in data parallel group of processors; zero-base
+    int id;
+    // Number of elements
+    long n;
+    // Number of cols
+    int ncol;
+    // Number of rows
+    int nrow;
+    // Number of local elements
+    int nLocal;
+    // First (global) index of local partition
+    long firstIndex;
+    // Total number of MPI processes
+    int np;
+
+    //
+    // AUXILIARY
+    //
+
+    // initializes distribution and planes.
+    void init();
+    // returns the index of the field with the given name, or -1.
+    int fieldIndex(const std::string& name) const;
+    // applies stage to the elements, converted to structs block by block.
+    void mapBlocks(const typename detail::Pipeline<T>::Stage& stage, bool isNative);
+};
+}
+
+//
+// BINDING FUNCTION
+//
+
+void bind_soadm(py::module& m);
@@ -0,0 +1,163 @@
+/*
+ * threadpool.h
+ *
+ * Persistent pool of worker threads of an MPI process. Native user functions
+ * (operators, expressions, compiled kernels and function pointers) are applied
+ * to chunks of the local partition by all threads of the pool, so that one
+ * process per node can use all of its cores.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace msl {
+
+/**
+ * \brief Class ThreadPool represents the worker threads of a process.
+ *
+ * The threads are started once and wait for work between calls of
+ * parallelFor(). The calling thread takes part in the work, so a pool of size
+ * 1 has no worker threads and runs everything serially.
+ *
+ * Work is scheduled by work stealing: each thread starts with a contiguous
+ * range and processes it chunk by chunk from the front. A thread that runs out
+ * of work takes the back half of the remaining range of another thread. Thus,
+ * ranges of similar cost keep their locality, while ranges of very different
+ * cost (e.g. the rows of a Mandelbrot image) are rebalanced until the end.
+ */
+class ThreadPool
+{
+public:
+  /**
+   * \brief A task applied to the index range [begin, end).
+   */
+  typedef std::function<void(int begin, int end)> Task;
+
+  /**
+   * \brief Default minimum number of elements per range.
+   */
+  static const int GRAIN = 4096;
+
+  /**
+   * \brief Starts \em numThreads - 1 worker threads. If \em cpus is not empty,
+   *        worker i (1 <= i < \em numThreads) is pinned to cpus[i % cpus.size()].
+   *        The calling thread is only pinned to cpus[0] while it takes part in
+   *        a parallelFor() and gets its own affinity back afterwards.
+   *
+   * @param numThreads Number of threads including the calling thread.
+   * @param cpus CPUs to pin the threads to.
+   */
+  explicit ThreadPool(int numThreads, const std::vector<int>& cpus = std::vector<int>());
+
+  /**
+   * \brief Stops and joins the worker threads.
+   */
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /**
+   * \brief Returns the number of threads including the calling thread.
+   */
+  int size() const;
+
+  /**
+   * \brief Applies \em task to chunks of [0, \em count) and waits until all of
+   *        them are done. Chunks have \em grain elements (except for the last
+   *        one of a range). Calls from inside a task run serially. If a task
+   *        throws, the remaining chunks are skipped and the first exception is
+   *        rethrown on the calling thread.
+   *
+   * @param count Number of elements.
+   * @param grain Number of elements per chunk.
+   * @param task The task.
+   */
+  void parallelFor(int count, int grain, const Task& task);
+
+private:
+  // remaining range [begin, end) of a thread, packed as begin << 32 | end
+  struct alignas(64) Range {
+    std::atomic<std::uint64_t> bounds;
+  };
+
+  void work(int worker);
+  void runPart(int part);
+  bool take(int part, int& begin, int& end);
+  bool steal(int part, int& begin, int& end);
+
+  std::vector<std::thread> workers;
+  // CPUs the threads are pinned to (empty if they are not pinned)
+  std::vector<int> cpus;
+  // serializes concurrent calls of parallelFor
+  std::mutex submit;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  // current job
+  const Task* task;
+  int count;
+  int grain;
+  int parts;
+  std::unique_ptr<Range[]> ranges;
+  // number of elements not yet processed
+  std::atomic<int> remaining;
+  // first exception thrown by a task of the current job
+  std::exception_ptr error;
+  std::atomic<bool> failed;
+  // incremented for every job, so that workers notice new work
+  long generation;
+  // number of workers still busy with the current job
+  int pending;
+  bool stop;
+};
+
+/**
+ * \brief Returns the thread pool of this process. It is (re)started with
+ *        getNumThreads() threads when the number of threads has changed.
+ */
+ThreadPool& threadPool();
+
+/**
+ * \brief Stops the thread pool of this process (used by terminateSkeletons()).
+ */
+void releaseThreadPool();
+
+/**
+ * \brief Pins the threads of the pool of this process to \em cpus (see the
+ *        constructor of ThreadPool); an empty list leaves their placement to the
+ *        operating system. Takes effect when the pool is (re)started.
+ *
+ * Since each thread starts with a contiguous range of a parallelFor(), a list
+ * ordered by NUMA node splits the local partitions into one contiguous part
+ * per NUMA node. Partitions are first touched the same way (see
+ * detail::allocatePartition()), so that each thread mostly works on memory of
+ * its own node. Stolen chunks are the exception.
+ */
+void pinThreads(const std::vector<int>& cpus);
+
+/**
+ * \brief Applies \em task to [0, \em count) using the thread pool of this
+ *        process. Serial if the range is smaller than two grains.
+ */
+inline void parallelFor(int count, int grain, const ThreadPool::Task& task)
+{
+  if (count < 2 * grain) {
+    if (count > 0) {
+      task(0, count);
+    }
+    return;
+  }
+  threadPool().parallelFor(count, grain, task);
+}
+
+}
@@ -15,20 +15,11 @@ def ppm(width, height, maxval, image):
 
 
 def convert(dm):
-    rows = dm.getRows()
-    cols = dm.getCols()
-    image = array.array('B', [0] * 3 * cols * rows)
-    index = 0
-
-    for row in range(0, rows):
-        for col in range(0, cols):
-            p = dm.get(row * cols + col)
-            image[index] = p.r
-            image[index+1] = p.g
-            image[index+2] = p.b
-            index += 3
-
-    return image
+    # only the root receives the pixels; the other processes get None
+    pixels = dm.gather()
+    if pixels is None:
+        return None
+    return array.array('B', pixels.tobytes())
 
 
 class Iterate:
@@ -64,16 +55,51 @@ class Iterate:
         return p
 
 
-def test_mandelbrot(rows, cols, max_iters, center_x, center_y, zoom, output):
+# C++ version of Iterate.cal_pixel, compiled at runtime;
+# p = [l, t, dx, dy, iter]
+CAL_PIXEL_KERNEL = """
+    int iters = 0;
+    int max_iters = (int) p[4];
+    double real = p[0] + col * p[2];
+    double imag = p[1] + row * p[3];
+    double tmpReal = real;
+    double tmpImag = imag;
+    while ((real * real) + (imag * imag) <= 4.0 && iters < max_iters) {
+        double nextReal = (real * real) - (imag * imag) + tmpReal;
+        imag = (2 * real * imag) + tmpImag;
+        real = nextReal;
+        iters++;
+    }
+    if (iters < max_iters) {
+        x.r = (iters & 63) << 1;
+        x.g = (iters << 3) & 255;
+        x.b = (iters >> 8) & 255;
+    }
+    return x;
+"""
+
+
+def test_mandelbrot(rows, cols, max_iters, center_x, center_y, zoom, output, mode=""):
     p = Pixel()
     # p.g = 255
 
-    mandelbrot = Mandelbrot(rows, cols, p)
-
     iterate = Iterate(max_iters, center_x, center_y, zoom, rows, cols)
-    mandelbrot.mapIndexInPlaceM(iterate.cal_pixel)
+    if mode == "soa":
+        # channels are stored in separate planes; gather returns the RGB image
+        mandelbrot = MandelbrotSoA(rows, cols, p)
+        mandelbrot.mapInPlaceKernel(CAL_PIXEL_KERNEL, [iterate.l, iterate.t, iterate.dx, iterate.dy, iterate.iter])
+        image = mandelbrot.gather()
+    else:
+        mandelbrot = Mandelbrot(rows, cols, p)
+        if mode == "jit":
+            mandelbrot.mapInPlaceKernel(CAL_PIXEL_KERNEL, [iterate.l, iterate.t, iterate.dx, iterate.dy, iterate.iter])
+        elif mode == "dynamic":
+            # rows are handed out to idle processes instead of fixed partitions
+            mandelbrot.mapIndexInPlaceMDynamic(iterate.cal_pixel)
+        else:
+            mandelbrot.mapIndexInPlaceM(iterate.cal_pixel)
 
-    image = convert(mandelbrot)
+        image = convert(mandelbrot)
 
     #if output:
         #ppm(cols, rows, 255, image)
@@ -87,10 +113,11 @@ if __name__ == "__main__":
     rows, cols, n_runs, n_gpus = 1000, 1000, 2, 0
     max_iters, zoom = 1000, 800
     output, warmup = 1, 0
+    mode = ""
 
     if len(sys.argv) < 7:
         if isRootProcess():
-            print("Usage: " + sys.argv[0] + " #rows #cols #maxIters #zoom #nRuns #nGPUs")
+            print("Usage: " + sys.argv[0] + " #rows #cols #maxIters #zoom #nRuns #nGPUs [jit|dynamic|soa]")
             string = "Default values: rows = " + str(rows) + \
                      ", cols = " + str(cols) + \
                      ", maxIters = " + str(max_iters) + \
@@ -106,18 +133,19 @@ if __name__ == "__main__":
         n_runs = int(sys.argv[5])
         n_gpus = int(sys.argv[6])
         output = True
+        mode = sys.argv[7] if len(sys.argv) > 7 else ""
 
     setNumRuns(n_runs)
     center_x = -0.73
     center_y = 0.0
 
     if warmup:
-        test_mandelbrot(rows, cols, max_iters, center_x, center_y, zoom, False)
+        test_mandelbrot(rows, cols, max_iters, center_x, center_y, zoom, False, mode)
 
     start = timeit.default_timer()
     runs = getNumRuns()
     for run in range(runs):
-        test_mandelbrot(rows, cols, max_iters, center_x, center_y, zoom, output)
+        test_mandelbrot(rows, cols, max_iters, center_x, center_y, zoom, output, mode)
     stop = timeit.default_timer()
     if isRootProcess():
         print(str(rows) + ";" + str(cols) + ";" + str(max_iters) + ";" + str(zoom) + ";" + str(n_runs) + ";" + str(
@@ -2,11 +2,15 @@
 #include "include/muesli.h"
 #include "include/dm.h"
 #include "include/da.h"
+#include "include/soadm.h"
+#include "include/operators.h"
 
 namespace py = pybind11;
 
 PYBIND11_MODULE(muesli, muesli_handle) {
     bind_muesli(muesli_handle);
+    bind_operators(muesli_handle);
     bind_da(muesli_handle);
     bind_dm(muesli_handle);
+    bind_soadm(muesli_handle);
 }
\ No newline at end of file
@@ -40,6 +40,9 @@
 #include <pybind11/stl.h>
 #include <pybind11/numpy.h>
 #include <pybind11/functional.h>
+#include <pybind11/complex.h>
+#include <cerrno>
+#include <cstring>
 
 using namespace std;
 
@@ -52,94 +55,311 @@ msl::DA<T>::DA():                       // distributed array (resides on GPUs un
         np(0),                       // number of (MPI-) nodes (= Muesli::num_local_procs)
         id(0),                       // id of local node among all nodes (= Muesli::proc_id)
         localPartition(0),           // local partition of the DA
+        views(0),                    // number of NumPy views of the local partition
+        pages(HugePages::NONE),      // pages backing the local partition
         firstIndex(0),               // first global index of the DA in the local partition
         firstRow(0)                  // first global row index of the DA on the local partition
 {}
 
 // constructor creates a non-initialized DA
 template<typename T>
-msl::DA<T>::DA(int n)
+msl::DA<T>::DA(long n)
         : n(n){
     init();
 }
 
 // constructor creates a DA, initialized with v
 template<typename T>
-msl::DA<T>::DA(int n, const T& v)
+msl::DA<T>::DA(long n, const T& v)
         : n(n){
     init();
     fill(v);
 }
 
+// constructor creates a DA whose local partition is mapped from a file
+template<typename T>
+msl::DA<T>::DA(long n, const std::string& path, bool perRank)
+        : n(n){
+    init(false);
+    attach(path, perRank);
+}
+
 // auxiliary method init()
 template<typename T>
-void msl::DA<T>::init() {
+void msl::DA<T>::init(bool allocateLocal) {
     if (Muesli::proc_entrance == UNDEFINED) {
         throws(detail::MissingInitializationException());
     }
     id = Muesli::proc_id;
     np = Muesli::num_total_procs;
-    nLocal = n / np;
+    if ((n + np - 1) / np > INT_MAX) {
+        throws(detail::PartitioningImpossibleException());
+        // left empty rather than with truncated partitions
+        n = 0;
+    }
+    nLocal = detail::partitionSize(n, np, id);
     nCPU = nLocal;
-    firstIndex =  id * nLocal;
-    localPartition = new T[nLocal];
+    firstIndex = detail::partitionStart(n, np, id);
+    pages = Muesli::huge_pages;
+    remote.open();
+    if (allocateLocal) {
+        allocate();
+    }
     // printf("loc processes %d , First index %d\n", Muesli::num_local_procs, firstIndex);
     // printf("Building datastructure with %d nodes and %d cpus\n", msl::Muesli::num_total_procs,
     //        msl::Muesli::num_local_procs);
 }
 
-// destructor removes a DA
+template<typename T>
+void msl::DA<T>::allocate() {
+    buffer = detail::allocatePartition<T>(nLocal, pages);
+    localPartition = buffer.get();
+    remote.expose(localPartition, nLocal);
+    views = 0;
+}
+
+template<typename T>
+void msl::DA<T>::attach(const std::string& path, bool perRank) {
+    std::string file = perRank ? path + "." + std::to_string(id) : path;
+    if (!perRank) {
+        // the root sizes the shared file once, so that the processes do not
+        // truncate each other's slices (failures are reported when mapping)
+        if (msl::isRootProcess()) {
+            detail::reserveFile(file, n * sizeof(T));
+        }
+        msl::barrier();
+    }
+    if (nLocal == 0) {
+        allocate();
+        return;
+    }
+    size_t offset = perRank ? 0 : firstIndex * sizeof(T);
+    buffer = detail::mapPartition<T>(file, offset, nLocal);
+    if (!buffer) {
+        throws(detail::FileMappingException(file, std::strerror(errno)));
+        allocate();
+        return;
+    }
+    localPartition = buffer.get();
+    remote.expose(localPartition, nLocal);
+    views = 0;
+}
+
+template<typename T>
+bool msl::DA<T>::isShared() const {
+    return buffer.use_count() - views > 1;
+}
+
+// destructor removes a DA; the local partition is released together with
+// the last copy referencing it
 template<typename T>
 msl::DA<T>::~DA() {
-    //printf("Destructor\n");
-    //delete[] localPartition;
 }
 
+// copies share the local partition, but not the NumPy views of the original
 template<typename T>
-void msl::DA<T>::fill(const T& value) {
-#pragma acc parallel loop
-    for (int k = 0; k < nLocal; k++) {
-        localPartition[k] = value;
+msl::DA<T>::DA(const DA<T>& other)
+    : localPartition(other.localPartition), buffer(other.buffer), views(0), pages(other.pages),
+      pipeline(other.pipeline), remote(other.remote), id(other.id), n(other.n), ncol(other.ncol), nrow(other.nrow),
+      nLocal(other.nLocal), firstIndex(other.firstIndex), firstRow(other.firstRow), np(other.np), nCPU(other.nCPU){
+}
+
+template<typename T>
+msl::DA<T>& msl::DA<T>::operator=(const DA<T>& other) {
+    if (this == &other) {
+        return *this;
+    }
+    // views of the current local partition keep counting if it stays the same
+    if (buffer != other.buffer) {
+        views = 0;
+    }
+    localPartition = other.localPartition;
+    buffer = other.buffer;
+    pages = other.pages;
+    pipeline = other.pipeline;
+    remote = other.remote;
+    id = other.id;
+    n = other.n;
+    ncol = other.ncol;
+    nrow = other.nrow;
+    nLocal = other.nLocal;
+    firstIndex = other.firstIndex;
+    firstRow = other.firstRow;
+    np = other.np;
+    nCPU = other.nCPU;
+    return *this;
+}
+
+// the moved-from container is left without elements
+template<typename T>
+msl::DA<T>::DA(DA<T>&& other)
+    : localPartition(other.localPartition), buffer(std::move(other.buffer)), views(0), pages(other.pages),
+      pipeline(std::move(other.pipeline)), remote(std::move(other.remote)), id(other.id), n(other.n), ncol(other.ncol),
+      nrow(other.nrow), nLocal(other.nLocal), firstIndex(other.firstIndex), firstRow(other.firstRow), np(other.np),
+      nCPU(other.nCPU){
+    other.abandon();
+}
+
+template<typename T>
+msl::DA<T>& msl::DA<T>::operator=(DA<T>&& other) {
+    if (this == &other) {
+        return *this;
     }
+    if (buffer != other.buffer) {
+        views = 0;
+    }
+    localPartition = other.localPartition;
+    buffer = std::move(other.buffer);
+    pages = other.pages;
+    pipeline = std::move(other.pipeline);
+    remote = std::move(other.remote);
+    id = other.id;
+    n = other.n;
+    ncol = other.ncol;
+    nrow = other.nrow;
+    nLocal = other.nLocal;
+    firstIndex = other.firstIndex;
+    firstRow = other.firstRow;
+    np = other.np;
+    nCPU = other.nCPU;
+    other.abandon();
+    return *this;
+}
+
+template<typename T>
+void msl::DA<T>::abandon() {
+    localPartition = nullptr;
+    buffer.reset();
+    views = 0;
+    pipeline.clear();
+    n = 0;
+    ncol = 0;
+    nrow = 0;
+    nLocal = 0;
+    nCPU = 0;
+}
+
+template<typename T>
+void msl::DA<T>::fill(const T& value) {
+    prepareOverwrite();
+    T* out = localPartition;
+    parallelFor(nLocal, ThreadPool::GRAIN, [out, &value](int begin, int end) {
+        std::fill(out + begin, out + end, value);
+    });
 }
 
 // **************************** auxiliary methods ****************************
 
 template<typename T>
-T* msl::DA<T>::getLocalPartition() {
-    return localPartition;
+py::array_t<T> msl::DA<T>::getLocalPartition() {
+    prepareWrite();
+    return localView({nLocal});
+}
+
+template<typename T>
+py::array_t<T> msl::DA<T>::localView(const std::vector<py::ssize_t>& shape) {
+    // the view keeps the DA and its local partition alive; it does not count
+    // as a copy sharing the local partition
+    struct View {
+        py::object owner;
+        std::shared_ptr<T> buffer;
+        DA<T>* da;
+    };
+    View* view = new View{py::cast(this, py::return_value_policy::reference), buffer, this};
+    views++;
+    py::capsule base(view, [](void* p) {
+        View* view = static_cast<View*>(p);
+        if (view->da->buffer == view->buffer) {
+            view->da->views--;
+        }
+        delete view;
+    });
+
+    return py::array_t<T>(shape, localPartition, base);
 }
 
 template<typename T>
 void msl::DA<T>::setLocalPartition(py::array_t<T> array) {
-#pragma acc parallel loop
-    for (int k = 0; k < nCPU; k++) {
-        localPartition[k] = *array.data(k);
+    if (!detail::checkArray(array, nCPU)) {
+        return;
+    }
+    prepareOverwrite();
+    detail::copyFromArray(array, 0, localPartition, nCPU);
+}
+
+template<typename T>
+void msl::DA<T>::adoptLocalPartition(py::array_t<T> array) {
+    if (!detail::adoptable(array, nLocal)) {
+        setLocalPartition(array);
+        return;
     }
+    pipeline.clear();
+    buffer = detail::adopt(array);
+    localPartition = buffer.get();
+    remote.expose(localPartition, nLocal);
+    views = 0;
+}
+
+template<typename T>
+void msl::DA<T>::setHugePages(HugePages pages) {
+    prepareWrite();
+    this->pages = pages;
+    std::shared_ptr<T> source = buffer;
+    allocate();
+    std::copy(source.get(), source.get() + nLocal, localPartition);
 }
 
 template<typename T>
 void msl::DA<T>::setArray(py::array_t<T> array) {
-#pragma acc parallel loop
-    for (int k = 0; k < nCPU; k++) {
-        localPartition[k] = *array.data(firstIndex+k);
+    if (!detail::checkArray(array, firstIndex + nCPU)) {
+        return;
+    }
+    prepareOverwrite();
+    detail::copyFromArray(array, firstIndex, localPartition, nCPU);
+}
+
+template<typename T>
+void msl::DA<T>::scatterFrom(int root, py::object array) {
+    if (root < 0 || root >= np) {
+        throws(detail::UndefinedSourceException());
+        return;
+    }
+    // the root tells the others whether its array can be distributed
+    py::array_t<T, py::array::c_style | py::array::forcecast> source;
+    int valid = 1;
+    if (id == root) {
+        source = py::array_t<T, py::array::c_style | py::array::forcecast>::ensure(array);
+        if (!source) {
+            throws(detail::IllegalArrayException("expected an array"));
+            valid = 0;
+        } else if (!detail::checkArray(source, n)) {
+            valid = 0;
+        }
+    }
+    msl::MSL_Broadcast(root, &valid, 1);
+    if (!valid) {
+        return;
     }
+    prepareOverwrite();
+    msl::scatterv(id == root ? source.data() : (const T*) nullptr, localPartition, partitionBounds().data(), root);
 }
 
 template<typename T>
-T msl::DA<T>::get(int index) const {
+T msl::DA<T>::get(long index) {
     int idSource;
     T message;
+    evaluate();
     // TODO: adjust to new structure
     // element with global index is locally stored
     if (isLocal(index)) {
+        detail::advise(localPartition, detail::Access::RANDOM);
         message = localPartition[index - firstIndex];
         idSource = Muesli::proc_id;
     }
         // Element with global index is not locally stored
     else {
         // Calculate id of the process that stores the element locally
-        idSource = (int) (index / nLocal);
+        idSource = ownerOf(index);
     }
 
     msl::MSL_Broadcast(idSource, &message, 1);
@@ -147,7 +367,30 @@ T msl::DA<T>::get(int index) const {
 }
 
 template<typename T>
-int msl::DA<T>::getSize() const {
+py::array_t<T> msl::DA<T>::getMany(py::array_t<long, py::array::c_style | py::array::forcecast> indices) {
+    evaluate();
+    py::array_t<T> result(std::vector<py::ssize_t>(indices.shape(), indices.shape() + indices.ndim()));
+    detail::fetchElements(localPartition, partitionBounds(), indices.data(), indices.size(), result.mutable_data());
+    return result;
+}
+
+template<typename T>
+py::array_t<T> msl::DA<T>::getRange(long start, long stop) {
+    evaluate();
+    std::vector<long> bounds = partitionBounds();
+    detail::checkRange(start, stop, bounds);
+    py::array_t<T> result(stop - start);
+    detail::fetchRange(localPartition, bounds, start, stop, result.mutable_data());
+    return result;
+}
+
+template<typename T>
+std::vector<long> msl::DA<T>::partitionBounds() const {
+    return detail::partitionBounds(n, np);
+}
+
+template<typename T>
+long msl::DA<T>::getSize() const {
     return n;
 }
 
@@ -157,12 +400,12 @@ int msl::DA<T>::getLocalSize() const {
 }
 
 template<typename T>
-int msl::DA<T>::getFirstIndex() const {
+long msl::DA<T>::getFirstIndex() const {
     return firstIndex;
 }
 
 template<typename T>
-bool msl::DA<T>::isLocal(int index) const {
+bool msl::DA<T>::isLocal(long index) const {
     return (index >= firstIndex) && (index < firstIndex + nLocal);
 }
 
@@ -170,35 +413,91 @@ template<typename T>
 T msl::DA<T>::getLocal(int localIndex) {
     if (localIndex >= nLocal)
         throws(detail::NonLocalAccessException());
+    evaluate();
     return localPartition[localIndex];
 }
 
 template<typename T>
 void msl::DA<T>::setLocal(int localIndex, const T& v) {
     if (localIndex < nCPU) {
+        prepareWrite();
         localPartition[localIndex] = v;
     } else if (localIndex >= nLocal)
         throws(detail::NonLocalAccessException());
 }
 
 template<typename T>
-void msl::DA<T>::set(int globalIndex, const T& v) {
+void msl::DA<T>::set(long globalIndex, const T& v) {
     if ((globalIndex >= firstIndex) && (globalIndex < firstIndex + nLocal)) {
+        detail::advise(localPartition, detail::Access::RANDOM);
         setLocal(globalIndex - firstIndex, v);
     }
 }
 
+template<typename T>
+T msl::DA<T>::remoteGet(long index) {
+    T value = T();
+    if (index < 0 || index >= n) {
+        throws(detail::IllegalGetException());
+        return value;
+    }
+    int owner = ownerOf(index);
+    if (!remote.get(&value, owner, (int) (index - firstIndexOf(owner)), 1)) {
+        throws(detail::IllegalGetException());
+    }
+    return value;
+}
+
+template<typename T>
+void msl::DA<T>::remotePut(long index, const T& v) {
+    if (index < 0 || index >= n) {
+        throws(detail::IllegalPutException());
+        return;
+    }
+    int owner = ownerOf(index);
+    if (!remote.put(&v, owner, (int) (index - firstIndexOf(owner)), 1)) {
+        throws(detail::IllegalPutException());
+    }
+}
+
+template<typename T>
+void msl::DA<T>::accumulate(long index, const T& v, Operator op) {
+    MPI_Op reduction = accumulation<T>(op);
+    if (reduction == MPI_OP_NULL) {
+        return;
+    }
+    if (index < 0 || index >= n) {
+        throws(detail::IllegalPutException());
+        return;
+    }
+    int owner = ownerOf(index);
+    if (!remote.accumulate(&v, owner, (int) (index - firstIndexOf(owner)), 1, reduction)) {
+        throws(detail::IllegalPutException());
+    }
+}
+
+template<typename T>
+int msl::DA<T>::ownerOf(long index) const {
+    return detail::partitionOwner(n, np, index);
+}
+
+template<typename T>
+long msl::DA<T>::firstIndexOf(int rank) const {
+    return detail::partitionStart(n, np, rank);
+}
+
 // method (only) useful for debugging
 template<typename T>
 //void msl::DA<T>::showLocal(const std::string& descr) {
 void msl::DA<T>::showLocal() {
+    evaluate();
     if (msl::isRootProcess()) {
         std::ostringstream s;
 //    if (descr.size() > 0)
 //    s << descr << ": ";
         s << "[";
         for (int i = 0; i < nLocal; i++) {
-            s << localPartition[i] << " ";
+            s << detail::printable(localPartition[i]) << " ";
         }
         s << "]" << std::endl;
         printf("%s", s.str().c_str());
@@ -207,31 +506,49 @@ void msl::DA<T>::showLocal() {
 
 template<typename T>
 void msl::DA<T>::show() {
-    T* b = new T[n];
+    std::vector<T> b(msl::isRootProcess() ? n : 0);
     std::ostringstream s;
-    msl::allgather(localPartition, b, nLocal);
+    evaluate();
+    msl::gatherv(localPartition, b.data(), partitionBounds().data(), 0);
 
     if (msl::isRootProcess()) {
         s << "[";
-        for (int i = 0; i < n - 1; i++) {
-            s << b[i];
+        for (long i = 0; i < n - 1; i++) {
+            s << detail::printable(b[i]);
             s << " ";
         }
-        s << b[n - 1] << "]" << std::endl;
+        s << detail::printable(b[n - 1]) << "]" << std::endl;
         s << std::endl;
     }
 
-    delete b;
-
     if (msl::isRootProcess()) printf("%s", s.str().c_str());
 }
 
 // SKELETONS / COMMUNICATION / GATHER
 
 template<typename T>
-py::array_t<T> msl::DA<T>::gather() {
+py::object msl::DA<T>::gather(int root) {
+    if (root < 0 || root >= np) {
+        throws(detail::UndefinedDestinationException());
+        return py::none();
+    }
+    evaluate();
+    detail::advise(localPartition, detail::Access::SEQUENTIAL);
+    // only the root allocates the array
+    py::array_t<T> array(id == root ? n : 0);
+    msl::gatherv(localPartition, array.mutable_data(), partitionBounds().data(), root);
+    if (id != root) {
+        return py::none();
+    }
+    return std::move(array);
+}
+
+template<typename T>
+py::array_t<T> msl::DA<T>::gatherAll() {
     T* array = new T[n];
-    msl::allgather(localPartition, array, nLocal);
+    evaluate();
+    detail::advise(localPartition, detail::Access::SEQUENTIAL);
+    msl::allgatherv(localPartition, array, partitionBounds().data());
 
     // Create a Python object that will free the allocated
     // memory when destroyed:
@@ -246,79 +563,504 @@ py::array_t<T> msl::DA<T>::gather() {
             free_when_done); // numpy array references this parent
 }
 
+//******************************** Evaluation ********************************
+template<typename T>
+void msl::DA<T>::evaluate() {
+    if (pipeline.empty()) {
+        return;
+    }
+    // write to a new local partition if the current one is shared with a copy
+    bool shared = isShared();
+    std::shared_ptr<T> source = buffer;
+    detail::advise(source.get(), detail::Access::SEQUENTIAL);
+    if (shared) {
+        allocate();
+    }
+    pipeline.run(source.get(), localPartition, nCPU, firstIndex);
+    pipeline.clear();
+}
+
+template<typename T>
+void msl::DA<T>::flush() {
+    evaluate();
+    detail::flushMapping(localPartition);
+}
+
+template<typename T>
+void msl::DA<T>::prepareWrite() {
+    evaluate();
+    if (isShared()) {
+        std::shared_ptr<T> source = buffer;
+        allocate();
+        std::copy(source.get(), source.get() + nLocal, localPartition);
+    }
+}
+
+template<typename T>
+void msl::DA<T>::prepareOverwrite() {
+    pipeline.clear();
+    if (isShared()) {
+        allocate();
+    }
+}
+
+template<typename T>
+void msl::DA<T>::finishMap() {
+    if (!Muesli::lazy_evaluation) {
+        evaluate();
+    }
+}
+
+template<typename T>
+bool msl::DA<T>::prepareDestination(DA<T>& out) {
+    if (out.n != n) {
+        throws(detail::IllegalPartitionException());
+        return false;
+    }
+    if (&out == this) {
+        return true;
+    }
+    // out keeps its local partition; copying the elements of this array is
+    // the first stage of its pipeline, followed by the pending maps of this array
+    out.pipeline.clear();
+    // With lazy evaluation, the pending maps of this array may still read the
+    // local partition of out (e.g. the copy of the previous step when alternating
+    // between two arrays). Applying them first lets out keep its partition
+    // instead of allocating a new one and extending the pipeline in every step.
+    if (out.isShared() && !pipeline.empty()) {
+        evaluate();
+    }
+    out.prepareOverwrite();
+    std::shared_ptr<T> source = buffer;
+    long offset = firstIndex;
+    out.pipeline.push([source, offset](T* block, int count, long first) {
+        const T* in = source.get() + (first - offset);
+        std::copy(in, in + count, block);
+    }, true);
+    out.pipeline.append(pipeline);
+    return true;
+}
+
 //*********************************** Maps ***********************************
 template<typename T>
 void msl::DA<T>::mapInPlace(const std::function<T(T)> &f) {
-#pragma acc parallel loop
-    for (int k = 0; k < nCPU; k++) {
-        setLocal(k, f(localPartition[k]));
+    pipeline.push([f](T* block, int count, long first) {
+        for (int k = 0; k < count; k++) {
+            block[k] = f(block[k]);
+        }
+    }, false);
+    finishMap();
+}
+
+template<typename T>
+void msl::DA<T>::mapIndexInPlace(const std::function<T(long,T)> &f) {
+    pipeline.push([f](T* block, int count, long first) {
+        for (int k = 0; k < count; k++) {
+            block[k] = f(first + k, block[k]);
+        }
+    }, false);
+    finishMap();
+}
+
+template<typename T>
+msl::DA<T> msl::DA<T>::map(const std::function<T(T)> &f) {
+    DA<T> result(*this);
+    result.mapInPlace(f);
+
+    return result;
+}
+
+template<typename T>
+msl::DA<T> msl::DA<T>::mapIndex(const std::function<T(long,T)> &f) {
+    DA<T> result(*this);
+    result.mapIndexInPlace(f);
+
+    return result;
+}
+
+template<typename T>
+void msl::DA<T>::mapTo(const std::function<T(T)> &f, DA<T>& out) {
+    if (prepareDestination(out)) {
+        out.mapInPlace(f);
+    }
+}
+
+template<typename T>
+void msl::DA<T>::mapIndexTo(const std::function<T(long,T)> &f, DA<T>& out) {
+    if (prepareDestination(out)) {
+        out.mapIndexInPlace(f);
     }
 }
 
+//****************************** Native Maps *******************************
 template<typename T>
-void msl::DA<T>::mapIndexInPlace(const std::function<T(int,T)> &f) {
+void msl::DA<T>::mapInPlace(T (*f)(T)) {
+    pipeline.push([f](T* block, int count, long first) {
+        for (int k = 0; k < count; k++) {
+            block[k] = f(block[k]);
+        }
+    }, true, detail::Pipeline<T>::FINE_BLOCK);
+    finishMap();
+}
+
+template<typename T>
+void msl::DA<T>::mapIndexInPlace(T (*f)(long,T)) {
+    pipeline.push([f](T* block, int count, long first) {
+        for (int k = 0; k < count; k++) {
+            block[k] = f(first + k, block[k]);
+        }
+    }, true, detail::Pipeline<T>::FINE_BLOCK);
+    finishMap();
+}
+
+template<typename T>
+msl::DA<T> msl::DA<T>::map(T (*f)(T)) {
+    DA<T> result(*this);
+    result.mapInPlace(f);
+
+    return result;
+}
+
+template<typename T>
+msl::DA<T> msl::DA<T>::mapIndex(T (*f)(long,T)) {
+    DA<T> result(*this);
+    result.mapIndexInPlace(f);
+
+    return result;
+}
 
-    // all necessary calculations are performed otherwise some are skipped.
-#pragma acc parallel loop
-    for (int k = 0; k < nCPU; k++) {
-        int globalindex = k + firstIndex;
-        localPartition[k] = f(globalindex, localPartition[k]);
+template<typename T>
+void msl::DA<T>::mapTo(T (*f)(T), DA<T>& out) {
+    if (prepareDestination(out)) {
+        out.mapInPlace(f);
     }
 }
 
 template<typename T>
-msl::DA<T> msl::DA<T>::map(const std::function<T(T)> &f) {
-    DA<T> result(n);
+void msl::DA<T>::mapIndexTo(T (*f)(long,T), DA<T>& out) {
+    if (prepareDestination(out)) {
+        out.mapIndexInPlace(f);
+    }
+}
+
+//**************************** Expression Maps *****************************
+template<typename T>
+void msl::DA<T>::mapInPlaceExpr(const std::string& expr) {
+    Expression e(expr, arrayVariables());
+    if (!e.isValid()) {
+        return;
+    }
+    pipeline.push([e](T* block, int count, long first) {
+        evaluateExpression(e, block, block, count, first, 0);
+    }, true);
+    finishMap();
+}
+
+template<typename T>
+msl::DA<T> msl::DA<T>::mapExpr(const std::string& expr) {
+    DA<T> result(*this);
+    result.mapInPlaceExpr(expr);
+
+    return result;
+}
+
+//**************************** Compiled Kernels ****************************
+template<typename T>
+void msl::DA<T>::mapInPlaceKernel(const std::string& body, const std::vector<double>& params) {
+    Kernel kernel = Kernel::create<T>(body);
+    if (!kernel.isValid()) {
+        return;
+    }
+    pipeline.push([kernel, params](T* block, int count, long first) {
+        kernel.run(block, block, count, first, 0, params);
+    }, true, detail::Pipeline<T>::FINE_BLOCK);
+    finishMap();
+}
+
+template<typename T>
+msl::DA<T> msl::DA<T>::mapKernel(const std::string& body, const std::vector<double>& params) {
+    DA<T> result(*this);
+    result.mapInPlaceKernel(body, params);
+
+    return result;
+}
+
+//*********************************** Zips ***********************************
+template<typename T>
+void msl::DA<T>::zipInPlace(DA<T>& b, const std::function<T(T,T)> &f) {
+    if (b.n != n) {
+        throws(detail::IllegalPartitionException());
+        return;
+    }
+    // the stage reads the current local partition of b, even if b changes later
+    b.evaluate();
+    std::shared_ptr<T> other = b.buffer;
+    long offset = firstIndex;
+    pipeline.push([f, other, offset](T* block, int count, long first) {
+        const T* in = other.get() + (first - offset);
+        for (int k = 0; k < count; k++) {
+            block[k] = f(block[k], in[k]);
+        }
+    }, false);
+    finishMap();
+}
+
+template<typename T>
+msl::DA<T> msl::DA<T>::zip(DA<T>& b, const std::function<T(T,T)> &f) {
+    DA<T> result(*this);
+    result.zipInPlace(b, f);
+
+    return result;
+}
 
-#pragma acc parallel loop
-    for (int k = 0; k < nCPU; k++){
-        result.setLocal(k, f(localPartition[k]));
+//******************************* Batched Maps *******************************
+template<typename T>
+void msl::DA<T>::mapInPlaceBatch(const std::function<detail::BatchArray<T>(py::array_t<T>)> &f) {
+    prepareWrite();
+    int batch = detail::batchSize(nCPU);
+    for (int k = 0; k < nCPU; k += batch) {
+        int count = std::min(batch, nCPU - k);
+        detail::batchStore(f(detail::batchView(localPartition + k, count)), localPartition + k, count);
     }
+}
+
+template<typename T>
+void msl::DA<T>::mapIndexInPlaceBatch(const std::function<detail::BatchArray<T>(py::array_t<long>, py::array_t<T>)> &f) {
+    prepareWrite();
+    int batch = detail::batchSize(nCPU);
+    for (int k = 0; k < nCPU; k += batch) {
+        int count = std::min(batch, nCPU - k);
+        py::array_t<long> indices = detail::batchIndices(k + firstIndex, count);
+        detail::batchStore(f(indices, detail::batchView(localPartition + k, count)), localPartition + k, count);
+    }
+}
+
+template<typename T>
+msl::DA<T> msl::DA<T>::mapBatch(const std::function<detail::BatchArray<T>(py::array_t<T>)> &f) {
+    DA<T> result(*this);
+    result.mapInPlaceBatch(f);
 
     return result;
 }
 
 template<typename T>
-msl::DA<T> msl::DA<T>::mapIndex(const std::function<T(int,T)> &f) {
-    DA<T> result(n);
+msl::DA<T> msl::DA<T>::mapIndexBatch(const std::function<detail::BatchArray<T>(py::array_t<long>, py::array_t<T>)> &f) {
+    DA<T> result(*this);
+    result.mapIndexInPlaceBatch(f);
 
-#pragma acc parallel loop
-    for (int k = 0; k < nCPU; k++){
-        int globalindex = k + firstIndex;
-        result.setLocal(k, f(globalindex, localPartition[k]));
+    return result;
+}
+
+//************************** Maps of Distinct Values **************************
+template<typename T>
+void msl::DA<T>::mapInPlaceUnique(const std::function<T(T)> &f) {
+    prepareWrite();
+    std::vector<T> values;
+    std::vector<int> codes;
+    detail::uniqueValues(localPartition, nCPU, values, codes);
+    for (T& value : values) {
+        value = f(value);
     }
+    T* out = localPartition;
+    const T* results = values.data();
+    const int* in = codes.data();
+    parallelFor(nCPU, ThreadPool::GRAIN, [out, results, in](int begin, int end) {
+        for (int k = begin; k < end; k++) {
+            out[k] = results[in[k]];
+        }
+    });
+}
+
+template<typename T>
+msl::DA<T> msl::DA<T>::mapUnique(const std::function<T(T)> &f) {
+    DA<T> result(*this);
+    result.mapInPlaceUnique(f);
 
     return result;
 }
 
+//************************** Native Operator Maps ****************************
+template<typename T>
+void msl::DA<T>::mapInPlaceOp(Operator op, const T& a, const T& b) {
+    if (!checkOperator(op, a, b)) {
+        return;
+    }
+    pipeline.push([op, a, b](T* block, int count, long first) {
+        applyOperator(op, block, block, count, a, b);
+    }, true);
+    finishMap();
+}
+
+template<typename T>
+void msl::DA<T>::mapInPlaceOp(const std::string& name, const T& a, const T& b) {
+    Operator op;
+    if (parseOperator(name, op)) {
+        mapInPlaceOp(op, a, b);
+    }
+}
+
+template<typename T>
+msl::DA<T> msl::DA<T>::mapOp(Operator op, const T& a, const T& b) {
+    DA<T> result(*this);
+    result.mapInPlaceOp(op, a, b);
+
+    return result;
+}
+
+template<typename T>
+msl::DA<T> msl::DA<T>::mapOp(const std::string& name, const T& a, const T& b) {
+    Operator op;
+    if (!parseOperator(name, op)) {
+        return DA<T>(*this);
+    }
+    return mapOp(op, a, b);
+}
+
+template<typename T>
+template<typename R>
+msl::DA<R> msl::DA<T>::mapCast() {
+    DA<R> result(n);
+    R* out = result.localPartition;
+    evaluate();
+    const T* in = localPartition;
+    parallelFor(nCPU, ThreadPool::GRAIN, [in, out](int begin, int end) {
+        for (int k = begin; k < end; k++) {
+            out[k] = static_cast<R>(in[k]);
+        }
+    });
+
+    return result;
+}
+
+namespace {
+
+// binds the members of DA<T> that use native functions or ordered arithmetic
+template<typename T>
+void bindArithmetic(py::class_<msl::DA<T>>& c) {
+    typedef msl::DA<T> DA;
+    c.def("mapInPlace", msl::detail::nativeOrPython<T(T)>(&DA::mapInPlace, &DA::mapInPlace))
+     .def("mapIndexInPlace", msl::detail::nativeOrPython<T(long,T)>(&DA::mapIndexInPlace, &DA::mapIndexInPlace))
+     .def("map", msl::detail::nativeOrPython<T(T)>(&DA::map, &DA::map))
+     .def("mapIndex", msl::detail::nativeOrPython<T(long,T)>(&DA::mapIndex, &DA::mapIndex))
+     .def("mapTo", msl::detail::nativeOrPython<T(T)>(&DA::mapTo, &DA::mapTo))
+     .def("mapIndexTo", msl::detail::nativeOrPython<T(long,T)>(&DA::mapIndexTo, &DA::mapIndexTo))
+     .def("mapInPlaceKernel", &DA::mapInPlaceKernel, py::arg("body"), py::arg("params") = std::vector<double>(),
+          py::call_guard<py::gil_scoped_release>())
+     .def("mapKernel", &DA::mapKernel, py::arg("body"), py::arg("params") = std::vector<double>(),
+          py::call_guard<py::gil_scoped_release>())
+     .def("mapInPlaceUnique", &DA::mapInPlaceUnique)
+     .def("mapUnique", &DA::mapUnique)
+     .def("mapInPlaceExpr", &DA::mapInPlaceExpr, py::call_guard<py::gil_scoped_release>())
+     .def("mapExpr", &DA::mapExpr, py::call_guard<py::gil_scoped_release>())
+     .def("mapInPlaceOp", py::overload_cast<msl::Operator, const T&, const T&>(&DA::mapInPlaceOp),
+          py::arg("op"), py::arg("a") = 0, py::arg("b") = 0, py::call_guard<py::gil_scoped_release>())
+     .def("mapInPlaceOp", py::overload_cast<const std::string&, const T&, const T&>(&DA::mapInPlaceOp),
+          py::arg("op"), py::arg("a") = 0, py::arg("b") = 0, py::call_guard<py::gil_scoped_release>())
+     .def("mapOp", py::overload_cast<msl::Operator, const T&, const T&>(&DA::mapOp),
+          py::arg("op"), py::arg("a") = 0, py::arg("b") = 0, py::call_guard<py::gil_scoped_release>())
+     .def("mapOp", py::overload_cast<const std::string&, const T&, const T&>(&DA::mapOp),
+          py::arg("op"), py::arg("a") = 0, py::arg("b") = 0, py::call_guard<py::gil_scoped_release>())
+     .def("toInt", &DA::template mapCast<int>, py::call_guard<py::gil_scoped_release>())
+     .def("toFloat", &DA::template mapCast<float>, py::call_guard<py::gil_scoped_release>())
+     .def("toDouble", &DA::template mapCast<double>, py::call_guard<py::gil_scoped_release>());
+}
+
+// binds the maps of DA<T> for element types without native functions
+template<typename T>
+void bindPython(py::class_<msl::DA<T>>& c) {
+    typedef msl::DA<T> DA;
+    c.def("mapInPlace", py::overload_cast<const std::function<T(T)>&>(&DA::mapInPlace))
+     .def("mapIndexInPlace", py::overload_cast<const std::function<T(long,T)>&>(&DA::mapIndexInPlace))
+     .def("map", py::overload_cast<const std::function<T(T)>&>(&DA::map))
+     .def("mapIndex", py::overload_cast<const std::function<T(long,T)>&>(&DA::mapIndex))
+     .def("mapTo", py::overload_cast<const std::function<T(T)>&, DA&>(&DA::mapTo))
+     .def("mapIndexTo", py::overload_cast<const std::function<T(long,T)>&, DA&>(&DA::mapIndexTo));
+}
+
+// binds DA<T> as <name>DA (and <alias>DA)
+template<typename T>
+void bindDA(py::module& m) {
+    typedef msl::DA<T> DA;
+    std::string name = std::string(msl::detail::ElementName<T>::name()) + "DA";
+    py::class_<DA> c(m, name.c_str());
+    c.def(py::init())
+     .def(py::init<long>())
+     .def(py::init<long, T>())
+     .def(py::init<long, const std::string&, bool>(), py::arg("n"), py::arg("path"), py::arg("perRank") = false)
+     .def("fill", &DA::fill)
+     .def("mapInPlaceBatch", &DA::mapInPlaceBatch)
+     .def("mapIndexInPlaceBatch", &DA::mapIndexInPlaceBatch)
+     .def("mapBatch", &DA::mapBatch)
+     .def("mapIndexBatch", &DA::mapIndexBatch)
+     .def("zipInPlace", &DA::zipInPlace)
+     .def("zip", &DA::zip)
+     .def("evaluate", &DA::evaluate)
+     .def("flush", &DA::flush)
+     .def("getLocalPartition", &DA::getLocalPartition)
+     .def("setLocalPartition", &DA::setLocalPartition)
+     .def("adoptLocalPartition", &DA::adoptLocalPartition)
+     .def("setHugePages", &DA::setHugePages)
+     .def("setArray", &DA::setArray)
+     .def("scatterFrom", &DA::scatterFrom, py::arg("root"), py::arg("array") = py::none())
+     .def("get", &DA::get)
+     .def("getMany", &DA::getMany)
+     .def("getRange", &DA::getRange)
+     .def("set", &DA::set)
+     .def("remoteGet", &DA::remoteGet)
+     .def("remotePut", &DA::remotePut)
+     .def("accumulate", &DA::accumulate, py::arg("index"), py::arg("v"), py::arg("op") = msl::Operator::ADD)
+     .def("showLocal", &DA::showLocal)
+     .def("show", &DA::show)
+     .def("getSize", &DA::getSize)
+     .def("getLocalSize", &DA::getLocalSize)
+     .def("getFirstIndex", &DA::getFirstIndex)
+     .def("isLocal", &DA::isLocal)
+     .def("getLocal", &DA::getLocal)
+     .def("setLocal", &DA::setLocal)
+     .def("gather", &DA::gather, py::arg("root") = 0)
+     .def("gatherAll", &DA::gatherAll);
+    if constexpr (msl::detail::HasArithmetic<T>::value) {
+        bindArithmetic<T>(c);
+    } else {
+        bindPython<T>(c);
+    }
+    if (msl::detail::ElementName<T>::alias() != nullptr) {
+        m.attr((std::string(msl::detail::ElementName<T>::alias()) + "DA").c_str()) = c;
+    }
+}
+
+// creates a DA<T> holding the elements of array if its dtype is T
+template<typename T>
+bool fromArray(const py::array& array, py::object& result) {
+    if (!py::isinstance<py::array_t<T>>(array)) {
+        return false;
+    }
+    msl::DA<T> da((long) array.size());
+    da.setArray(py::reinterpret_borrow<py::array_t<T>>(array));
+    result = py::cast(std::move(da));
+    return true;
+}
+
+template<typename... Ts>
+void bindAll(py::module& m, msl::detail::TypeList<Ts...>) {
+    (bindDA<Ts>(m), ...);
+}
+
+template<typename... Ts>
+py::object fromAnyArray(const py::array& array, msl::detail::TypeList<Ts...>) {
+    py::object result = py::none();
+    if (!(fromArray<Ts>(array, result) || ...)) {
+        msl::throws(msl::detail::IllegalArrayException("unsupported dtype " + std::string(py::str(array.dtype()))));
+    }
+    return result;
+}
+
+}
+
 void bind_da(py::module& m) {
-    py::class_<msl::DA<int>>(m, "intDA")
-            .def(py::init())
-            .def(py::init<int>())
-            .def(py::init<int, int>())
-            .def("fill", &msl::DA<int>::fill)
-            .def("mapInPlace", &msl::DA<int>::mapInPlace)
-            .def("mapIndexInPlace", &msl::DA<int>::mapIndexInPlace)
-            .def("map", &msl::DA<int>::map)
-            .def("mapIndex", &msl::DA<int>::mapIndex)
-            .def("getLocalPartition", &msl::DA<int>::getLocalPartition)
-            .def("setLocalPartition", &msl::DA<int>::setLocalPartition)
-            .def("setArray", &msl::DA<int>::setArray)
-            .def("get", &msl::DA<int>::get)
-            .def("set", &msl::DA<int>::set)
-            .def("showLocal", &msl::DA<int>::showLocal)
-            .def("show", &msl::DA<int>::show)
-            .def("getSize", &msl::DA<int>::getSize)
-            .def("getLocalSize", &msl::DA<int>::getLocalSize)
-            .def("getFirstIndex", &msl::DA<int>::getFirstIndex)
-            .def("isLocal", &msl::DA<int>::isLocal)
-            .def("getLocal", &msl::DA<int>::getLocal)
-            .def("setLocal", &msl::DA<int>::setLocal)
-            .def("gather", &msl::DA<int>::gather)
-            ;
-    py::class_<msl::DA<float>>(m, "floatDA")
-            .def(py::init<int, float>())
-            .def("get", &msl::DA<float>::get)
-            .def("mapIndexInPlace", &msl::DA<float>::mapIndexInPlace)
-            ;
+    bindAll(m, msl::detail::ElementTypes());
+    // the element type follows the dtype of the array, e.g. int64DA for int64
+    m.def("DA", [](const py::array& array) {
+        return fromAnyArray(array, msl::detail::ElementTypes());
+    }, py::arg("array"));
 }
@@ -40,6 +40,9 @@
 #include <pybind11/stl.h>
 #include <pybind11/numpy.h>
 #include <pybind11/functional.h>
+#include <pybind11/complex.h>
+#include <cerrno>
+#include <cstring>
 
 using namespace std;
 
@@ -54,6 +57,8 @@ msl::DM<T>::DM():                       // distributed array (resides on GPUs un
       np(0),                       // number of (MPI-) nodes (= Muesli::num_local_procs)
       id(0),                       // id of local node among all nodes (= Muesli::proc_id)
       localPartition(0),           // local partition of the DM
+      views(0),                    // number of NumPy views of the local partition
+      pages(HugePages::NONE),      // pages backing the local partition
       firstIndex(0),               // first global index of the DM in the local partition
       firstRow(0)                  // first global row index of the DM on the local partition
 {}
@@ -61,49 +66,191 @@ msl::DM<T>::DM():                       // distributed array (resides on GPUs un
 // constructor creates a non-initialized DM
 template<typename T>
 msl::DM<T>::DM(int row, int col)
-    : ncol(col), nrow(row), n(col*row){
+    : ncol(col), nrow(row), n((long) col * row){
     init();
 }
 
 // constructor creates a DM, initialized with v
 template<typename T>
 msl::DM<T>::DM(int row, int col, const T& v)
-    : ncol(col), nrow(row), n(col*row){
+    : ncol(col), nrow(row), n((long) col * row){
     init();
     fill(v);
 }
 
+// constructor creates a DM whose local partition is mapped from a file
+template<typename T>
+msl::DM<T>::DM(int row, int col, const std::string& path, bool perRank)
+    : ncol(col), nrow(row), n((long) col * row){
+    init(false);
+    attach(path, perRank);
+}
+
 // auxiliary method init()
 template<typename T>
-void msl::DM<T>::init() {
+void msl::DM<T>::init(bool allocateLocal) {
   if (Muesli::proc_entrance == UNDEFINED) {
     throws(detail::MissingInitializationException());
   }
   id = Muesli::proc_id;
   np = Muesli::num_total_procs;
-  n = ncol * nrow;
-  nLocal = n / np;
+  n = (long) ncol * nrow;
+  if ((n + np - 1) / np > INT_MAX) {
+    throws(detail::PartitioningImpossibleException());
+    // left empty rather than with truncated partitions
+    nrow = 0;
+    ncol = 0;
+    n = 0;
+  }
+  nLocal = detail::partitionSize(n, np, id);
   nCPU = nLocal;
-  firstIndex =  id * nLocal;
-  localPartition = new T[nLocal];
+  firstIndex = detail::partitionStart(n, np, id);
+  pages = Muesli::huge_pages;
+  remote.open();
+  if (allocateLocal) {
+    allocate();
+  }
   // printf("loc processes %d , First index %d\n", Muesli::num_local_procs, firstIndex);
   // printf("Building datastructure with %d nodes and %d cpus\n", msl::Muesli::num_total_procs,
   //        msl::Muesli::num_local_procs);
 }
 
-// destructor removes a DM
+template<typename T>
+void msl::DM<T>::allocate() {
+  buffer = detail::allocatePartition<T>(nLocal, pages);
+  localPartition = buffer.get();
+  remote.expose(localPartition, nLocal);
+  views = 0;
+}
+
+template<typename T>
+void msl::DM<T>::attach(const std::string& path, bool perRank) {
+  std::string file = perRank ? path + "." + std::to_string(id) : path;
+  if (!perRank) {
+    // the root sizes the shared file once, so that the processes do not
+    // truncate each other's slices (failures are reported when mapping)
+    if (msl::isRootProcess()) {
+      detail::reserveFile(file, n * sizeof(T));
+    }
+    msl::barrier();
+  }
+  if (nLocal == 0) {
+    allocate();
+    return;
+  }
+  size_t offset = perRank ? 0 : firstIndex * sizeof(T);
+  buffer = detail::mapPartition<T>(file, offset, nLocal);
+  if (!buffer) {
+    throws(detail::FileMappingException(file, std::strerror(errno)));
+    allocate();
+    return;
+  }
+  localPartition = buffer.get();
+  remote.expose(localPartition, nLocal);
+  views = 0;
+}
+
+template<typename T>
+bool msl::DM<T>::isShared() const {
+  return buffer.use_count() - views > 1;
+}
+
+// destructor removes a DM; the local partition is released together with
+// the last copy referencing it
 template<typename T>
 msl::DM<T>::~DM() {
-  //printf("Destructor\n");
-  //delete[] localPartition;
+}
+
+// copies share the local partition, but not the NumPy views of the original
+template<typename T>
+msl::DM<T>::DM(const DM<T>& other)
+    : localPartition(other.localPartition), buffer(other.buffer), views(0), pages(other.pages),
+      pipeline(other.pipeline), remote(other.remote), id(other.id), n(other.n), ncol(other.ncol), nrow(other.nrow),
+      nLocal(other.nLocal), firstIndex(other.firstIndex), firstRow(other.firstRow), np(other.np), nCPU(other.nCPU){
+}
+
+template<typename T>
+msl::DM<T>& msl::DM<T>::operator=(const DM<T>& other) {
+  if (this == &other) {
+    return *this;
+  }
+  // views of the current local partition keep counting if it stays the same
+  if (buffer != other.buffer) {
+    views = 0;
+  }
+  localPartition = other.localPartition;
+  buffer = other.buffer;
+  pages = other.pages;
+  pipeline = other.pipeline;
+  remote = other.remote;
+  id = other.id;
+  n = other.n;
+  ncol = other.ncol;
+  nrow = other.nrow;
+  nLocal = other.nLocal;
+  firstIndex = other.firstIndex;
+  firstRow = other.firstRow;
+  np = other.np;
+  nCPU = other.nCPU;
+  return *this;
+}
+
+// the moved-from container is left without elements
+template<typename T>
+msl::DM<T>::DM(DM<T>&& other)
+    : localPartition(other.localPartition), buffer(std::move(other.buffer)), views(0), pages(other.pages),
+      pipeline(std::move(other.pipeline)), remote(std::move(other.remote)), id(other.id), n(other.n), ncol(other.ncol),
+      nrow(other.nrow), nLocal(other.nLocal), firstIndex(other.firstIndex), firstRow(other.firstRow), np(other.np),
+      nCPU(other.nCPU){
+  other.abandon();
+}
+
+template<typename T>
+msl::DM<T>& msl::DM<T>::operator=(DM<T>&& other) {
+  if (this == &other) {
+    return *this;
+  }
+  if (buffer != other.buffer) {
+    views = 0;
+  }
+  localPartition = other.localPartition;
+  buffer = std::move(other.buffer);
+  pages = other.pages;
+  pipeline = std::move(other.pipeline);
+  remote = std::move(other.remote);
+  id = other.id;
+  n = other.n;
+  ncol = other.ncol;
+  nrow = other.nrow;
+  nLocal = other.nLocal;
+  firstIndex = other.firstIndex;
+  firstRow = other.firstRow;
+  np = other.np;
+  nCPU = other.nCPU;
+  other.abandon();
+  return *this;
+}
+
+template<typename T>
+void msl::DM<T>::abandon() {
+  localPartition = nullptr;
+  buffer.reset();
+  views = 0;
+  pipeline.clear();
+  n = 0;
+  ncol = 0;
+  nrow = 0;
+  nLocal = 0;
+  nCPU = 0;
 }
 
 template<typename T>
 void msl::DM<T>::fill(const T& value) {
-    #pragma acc parallel loop
-    for (int k = 0; k < nLocal; k++) {
-        localPartition[k] = value;
-    }
+    prepareOverwrite();
+    T* out = localPartition;
+    parallelFor(nLocal, ThreadPool::GRAIN, [out, &value](int begin, int end) {
+        std::fill(out + begin, out + end, value);
+    });
 }
 
 // **************************** auxiliary methods ****************************
@@ -118,40 +265,120 @@ int msl::DM<T>::getCols() {
 }
 
 template<typename T>
-T* msl::DM<T>::getLocalPartition() {
-  return localPartition;
+py::array_t<T> msl::DM<T>::getLocalPartition() {
+  prepareWrite();
+  if (ncol > 0 && firstIndex % ncol == 0 && nLocal % ncol == 0) {
+    return localView({nLocal / ncol, ncol});
+  }
+  return localView({nLocal});
+}
+
+template<typename T>
+py::array_t<T> msl::DM<T>::localView(const std::vector<py::ssize_t>& shape) {
+  // the view keeps the DM and its local partition alive; it does not count
+  // as a copy sharing the local partition
+  struct View {
+    py::object owner;
+    std::shared_ptr<T> buffer;
+    DM<T>* dm;
+  };
+  View* view = new View{py::cast(this, py::return_value_policy::reference), buffer, this};
+  views++;
+  py::capsule base(view, [](void* p) {
+    View* view = static_cast<View*>(p);
+    if (view->dm->buffer == view->buffer) {
+      view->dm->views--;
+    }
+    delete view;
+  });
+
+  return py::array_t<T>(shape, localPartition, base);
 }
 
 template<typename T>
 void msl::DM<T>::setLocalPartition(py::array_t<T> array) {
-    #pragma acc parallel loop
-    for (int k = 0; k < nCPU; k++) {
-        localPartition[k] = *array.data(k);
+    if (!detail::checkArray(array, nCPU)) {
+        return;
     }
+    prepareOverwrite();
+    detail::copyFromArray(array, 0, localPartition, nCPU);
 }
 
+template<typename T>
+void msl::DM<T>::adoptLocalPartition(py::array_t<T> array) {
+    if (!detail::adoptable(array, nLocal)) {
+        setLocalPartition(array);
+        return;
+    }
+    pipeline.clear();
+    buffer = detail::adopt(array);
+    localPartition = buffer.get();
+    remote.expose(localPartition, nLocal);
+    views = 0;
+}
+
+// the matrix may be given as a (rows, cols) array in any memory order or as a
+// flat array in row-major order
 template<typename T>
 void msl::DM<T>::setMatrix(py::array_t<T> array) {
-    #pragma acc parallel loop
-    for (int k = 0; k < nCPU; k++) {
-        localPartition[k] = *array.data(firstIndex+k);
+    if (!detail::checkArray(array, firstIndex + nCPU)) {
+        return;
     }
+    prepareOverwrite();
+    detail::copyFromArray(array, firstIndex, localPartition, nCPU);
+}
+
+template<typename T>
+void msl::DM<T>::setHugePages(HugePages pages) {
+    prepareWrite();
+    this->pages = pages;
+    std::shared_ptr<T> source = buffer;
+    allocate();
+    std::copy(source.get(), source.get() + nLocal, localPartition);
 }
 
 template<typename T>
-T msl::DM<T>::get(int index) const {
+void msl::DM<T>::scatterFrom(int root, py::object array) {
+    if (root < 0 || root >= np) {
+        throws(detail::UndefinedSourceException());
+        return;
+    }
+    // the root tells the others whether its array can be distributed
+    py::array_t<T, py::array::c_style | py::array::forcecast> source;
+    int valid = 1;
+    if (id == root) {
+        source = py::array_t<T, py::array::c_style | py::array::forcecast>::ensure(array);
+        if (!source) {
+            throws(detail::IllegalArrayException("expected an array"));
+            valid = 0;
+        } else if (!detail::checkArray(source, n)) {
+            valid = 0;
+        }
+    }
+    msl::MSL_Broadcast(root, &valid, 1);
+    if (!valid) {
+        return;
+    }
+    prepareOverwrite();
+    msl::scatterv(id == root ? source.data() : (const T*) nullptr, localPartition, partitionBounds().data(), root);
+}
+
+template<typename T>
+T msl::DM<T>::get(long index) {
   int idSource;
   T message;
+  evaluate();
  // TODO: adjust to new structure
   // element with global index is locally stored
   if (isLocal(index)) {
+    detail::advise(localPartition, detail::Access::RANDOM);
     message = localPartition[index - firstIndex];
     idSource = Muesli::proc_id;
   }
   // Element with global index is not locally stored
   else {
     // Calculate id of the process that stores the element locally
-    idSource = (int) (index / nLocal);
+    idSource = ownerOf(index);
   }
 
   msl::MSL_Broadcast(idSource, &message, 1);
@@ -159,7 +386,30 @@ T msl::DM<T>::get(int index) const {
 }
 
 template<typename T>
-int msl::DM<T>::getSize() const {
+py::array_t<T> msl::DM<T>::getMany(py::array_t<long, py::array::c_style | py::array::forcecast> indices) {
+    evaluate();
+    py::array_t<T> result(std::vector<py::ssize_t>(indices.shape(), indices.shape() + indices.ndim()));
+    detail::fetchElements(localPartition, partitionBounds(), indices.data(), indices.size(), result.mutable_data());
+    return result;
+}
+
+template<typename T>
+py::array_t<T> msl::DM<T>::getRange(long start, long stop) {
+    evaluate();
+    std::vector<long> bounds = partitionBounds();
+    detail::checkRange(start, stop, bounds);
+    py::array_t<T> result(stop - start);
+    detail::fetchRange(localPartition, bounds, start, stop, result.mutable_data());
+    return result;
+}
+
+template<typename T>
+std::vector<long> msl::DM<T>::partitionBounds() const {
+    return detail::partitionBounds(n, np);
+}
+
+template<typename T>
+long msl::DM<T>::getSize() const {
   return n;
 }
 
@@ -169,12 +419,12 @@ int msl::DM<T>::getLocalSize() const {
 }
 
 template<typename T>
-int msl::DM<T>::getFirstIndex() const {
+long msl::DM<T>::getFirstIndex() const {
   return firstIndex;
 }
 
 template<typename T>
-bool msl::DM<T>::isLocal(int index) const {
+bool msl::DM<T>::isLocal(long index) const {
   return (index >= firstIndex) && (index < firstIndex + nLocal);
 }
 
@@ -182,32 +432,78 @@ template<typename T>
 T msl::DM<T>::getLocal(int localIndex) {
   if (localIndex >= nLocal)
     throws(detail::NonLocalAccessException());
+  evaluate();
   return localPartition[localIndex];
 }
 
 template<typename T>
 void msl::DM<T>::setLocal(int localIndex, const T& v) {
   if (localIndex < nCPU) {
+    prepareWrite();
     localPartition[localIndex] = v;
   } else if (localIndex >= nLocal)
     throws(detail::NonLocalAccessException());
 }
 
 template<typename T>
-void msl::DM<T>::set(int globalIndex, const T& v) {
+void msl::DM<T>::set(long globalIndex, const T& v) {
   if ((globalIndex >= firstIndex) && (globalIndex < firstIndex + nLocal)) {
+    detail::advise(localPartition, detail::Access::RANDOM);
     setLocal(globalIndex - firstIndex, v);
   }
 }
 
+template<typename T>
+T msl::DM<T>::remoteGet(long index) {
+  T value = T();
+  if (index < 0 || index >= n) {
+    throws(detail::IllegalGetException());
+    return value;
+  }
+  int owner = ownerOf(index);
+  if (!remote.get(&value, owner, (int) (index - firstIndexOf(owner)), 1)) {
+    throws(detail::IllegalGetException());
+  }
+  return value;
+}
+
+template<typename T>
+void msl::DM<T>::remotePut(long index, const T& v) {
+  if (index < 0 || index >= n) {
+    throws(detail::IllegalPutException());
+    return;
+  }
+  int owner = ownerOf(index);
+  if (!remote.put(&v, owner, (int) (index - firstIndexOf(owner)), 1)) {
+    throws(detail::IllegalPutException());
+  }
+}
+
+template<typename T>
+void msl::DM<T>::accumulate(long index, const T& v, Operator op) {
+  MPI_Op reduction = accumulation<T>(op);
+  if (reduction == MPI_OP_NULL) {
+    return;
+  }
+  if (index < 0 || index >= n) {
+    throws(detail::IllegalPutException());
+    return;
+  }
+  int owner = ownerOf(index);
+  if (!remote.accumulate(&v, owner, (int) (index - firstIndexOf(owner)), 1, reduction)) {
+    throws(detail::IllegalPutException());
+  }
+}
+
 // method (only) useful for debugging
 template<typename T>
 void msl::DM<T>::showLocal() {
+  evaluate();
   if (msl::isRootProcess()) {
     std::ostringstream s;
     s << "[";
     for (int i = 0; i < nLocal; i++) {
-      s << localPartition[i] << " ";
+      s << detail::printable(localPartition[i]) << " ";
     }
     s << "]" << std::endl;
     printf("%s", s.str().c_str());
@@ -216,32 +512,102 @@ void msl::DM<T>::showLocal() {
 
 template<typename T>
 void msl::DM<T>::show() {
-  T* b = new T[n];
+  std::vector<T> b(msl::isRootProcess() ? n : 0);
   std::ostringstream s;
+  evaluate();
 
-  msl::allgather(localPartition, b, nLocal);
+  msl::gatherv(localPartition, b.data(), partitionBounds().data(), 0);
 
   if (msl::isRootProcess()) {
     s << "[";
-    for (int i = 0; i < n - 1; i++) {
-      s << b[i];
+    for (long i = 0; i < n - 1; i++) {
+      s << detail::printable(b[i]);
       ((i+1) % ncol == 0) ? s << "\n " : s << " ";;
     }
-    s << b[n - 1] << "]" << std::endl;
+    s << detail::printable(b[n - 1]) << "]" << std::endl;
     s << std::endl;
   }
 
-  delete b;
-
   if (msl::isRootProcess()) printf("%s", s.str().c_str());
 }
 
 // SKELETONS / COMMUNICATION / GATHER
 
 template<typename T>
-py::array_t<T> msl::DM<T>::gather() {
+py::object msl::DM<T>::gather(int root) {
+    if (root < 0 || root >= np) {
+        throws(detail::UndefinedDestinationException());
+        return py::none();
+    }
+    evaluate();
+    detail::advise(localPartition, detail::Access::SEQUENTIAL);
+    // only the root allocates the array
+    py::array_t<T> array(std::vector<py::ssize_t>{id == root ? nrow : 0, ncol});
+    msl::gatherv(localPartition, array.mutable_data(), partitionBounds().data(), root);
+    if (id != root) {
+        return py::none();
+    }
+    return std::move(array);
+}
+
+template<typename T>
+py::object msl::DM<T>::gatherRegion(int r0, int r1, int c0, int c1, int root) {
+    if (root < 0 || root >= np) {
+        throws(detail::UndefinedDestinationException());
+        return py::none();
+    }
+    if (r0 < 0 || r1 > nrow || r0 > r1 || c0 < 0 || c1 > ncol || c0 > c1) {
+        throws(detail::IllegalGetException());
+        return py::none();
+    }
+    evaluate();
+    // the elements of the region stored by a process form a contiguous part of
+    // the region in row-major order, so each process packs and sends only these
+    std::vector<long> bounds(np + 1);
+    for (int rank = 0; rank <= np; rank++) {
+        bounds[rank] = regionOffset(firstIndexOf(rank), r0, r1, c0, c1);
+    }
+    std::vector<T> packed(bounds[id + 1] - bounds[id]);
+    if (!packed.empty()) {
+        long last = firstIndex + nLocal;
+        T* out = packed.data();
+        for (long row = std::max((long) r0, firstIndex / ncol); row < r1 && row * ncol < last; row++) {
+            long begin = std::max(row * ncol + c0, firstIndex);
+            long end = std::min(row * ncol + c1, last);
+            if (begin < end) {
+                out = std::copy(localPartition + (begin - firstIndex), localPartition + (end - firstIndex), out);
+            }
+        }
+    }
+    py::array_t<T> region(std::vector<py::ssize_t>{id == root ? r1 - r0 : 0, c1 - c0});
+    msl::gatherv(packed.data(), region.mutable_data(), bounds.data(), root);
+    if (id != root) {
+        return py::none();
+    }
+    return std::move(region);
+}
+
+template<typename T>
+long msl::DM<T>::regionOffset(long index, int r0, int r1, int c0, int c1) const {
+    if (ncol == 0) {
+        return 0;
+    }
+    long row = index / ncol;
+    long col = index % ncol;
+    // complete rows of the region before the row of index
+    long offset = (std::min(std::max(row, (long) r0), (long) r1) - r0) * (c1 - c0);
+    if (row >= r0 && row < r1) {
+        offset += std::min(std::max(col, (long) c0), (long) c1) - c0;
+    }
+    return offset;
+}
+
+template<typename T>
+py::array_t<T> msl::DM<T>::gatherAll() {
     T* array = new T[n];
-    msl::allgather(localPartition, array, nLocal);
+    evaluate();
+    detail::advise(localPartition, detail::Access::SEQUENTIAL);
+    msl::allgatherv(localPartition, array, partitionBounds().data());
 
     // Create a Python object that will free the allocated
     // memory when destroyed:
@@ -253,161 +619,721 @@ py::array_t<T> msl::DM<T>::gather() {
     });
 
     return py::array_t<T>(
-            {n,}, // shape
+            {nrow, ncol}, // shape
             array, // the data pointer
             free_when_done); // numpy array references this parent
 }
 
+//******************************** Evaluation ********************************
+template<typename T>
+void msl::DM<T>::evaluate() {
+    if (pipeline.empty()) {
+        return;
+    }
+    // write to a new local partition if the current one is shared with a copy
+    bool shared = isShared();
+    std::shared_ptr<T> source = buffer;
+    detail::advise(source.get(), detail::Access::SEQUENTIAL);
+    if (shared) {
+        allocate();
+    }
+    pipeline.run(source.get(), localPartition, nCPU, firstIndex);
+    pipeline.clear();
+}
+
+template<typename T>
+void msl::DM<T>::flush() {
+    evaluate();
+    detail::flushMapping(localPartition);
+}
+
+template<typename T>
+void msl::DM<T>::prepareWrite() {
+    evaluate();
+    if (isShared()) {
+        std::shared_ptr<T> source = buffer;
+        allocate();
+        std::copy(source.get(), source.get() + nLocal, localPartition);
+    }
+}
+
+template<typename T>
+void msl::DM<T>::prepareOverwrite() {
+    pipeline.clear();
+    if (isShared()) {
+        allocate();
+    }
+}
+
+template<typename T>
+void msl::DM<T>::finishMap() {
+    if (!Muesli::lazy_evaluation) {
+        evaluate();
+    }
+}
+
+template<typename T>
+bool msl::DM<T>::prepareDestination(DM<T>& out) {
+    if (out.nrow != nrow || out.ncol != ncol) {
+        throws(detail::IllegalPartitionException());
+        return false;
+    }
+    if (&out == this) {
+        return true;
+    }
+    // out keeps its local partition; copying the elements of this matrix is
+    // the first stage of its pipeline, followed by the pending maps of this matrix
+    out.pipeline.clear();
+    // With lazy evaluation, the pending maps of this matrix may still read the
+    // local partition of out (e.g. the copy of the previous step when alternating
+    // between two matrixs). Applying them first lets out keep its partition
+    // instead of allocating a new one and extending the pipeline in every step.
+    if (out.isShared() && !pipeline.empty()) {
+        evaluate();
+    }
+    out.prepareOverwrite();
+    std::shared_ptr<T> source = buffer;
+    long offset = firstIndex;
+    out.pipeline.push([source, offset](T* block, int count, long first) {
+        const T* in = source.get() + (first - offset);
+        std::copy(in, in + count, block);
+    }, true);
+    out.pipeline.append(pipeline);
+    return true;
+}
+
 //*********************************** Maps ***********************************
 template<typename T>
 void msl::DM<T>::mapInPlace(const std::function<T(T)> &f) {
-    #pragma acc parallel loop
-    for (int k = 0; k < nCPU; k++) {
-        setLocal(k, f(localPartition[k]));
+    pipeline.push([f](T* block, int count, long first) {
+        for (int k = 0; k < count; k++) {
+            block[k] = f(block[k]);
+        }
+    }, false);
+    finishMap();
+}
+
+template<typename T>
+void msl::DM<T>::mapIndexInPlace(const std::function<T(long,T)> &f) {
+    pipeline.push([f](T* block, int count, long first) {
+        for (int k = 0; k < count; k++) {
+            block[k] = f(first + k, block[k]);
+        }
+    }, false);
+    finishMap();
+}
+
+template<typename T>
+void msl::DM<T>::mapIndexInPlace2(const std::function<T(int,int,T)> &f) {
+    int cols = ncol;
+    pipeline.push([f, cols](T* block, int count, long first) {
+        for (int k = 0; k < count; k++) {
+            int row = (first + k) / cols;
+            int col = (first + k) % cols;
+            block[k] = f(row, col, block[k]);
+        }
+    }, false);
+    finishMap();
+}
+
+template<typename T>
+void msl::DM<T>::mapIndexInPlaceM(const std::function<T(int,int,T)> &f) {
+    mapIndexInPlace2(f);
+}
+
+template<typename T>
+msl::DM<T> msl::DM<T>::map(const std::function<T(T)> &f) {
+    DM<T> result(*this);
+    result.mapInPlace(f);
+
+    return result;
+}
+
+template<typename T>
+msl::DM<T> msl::DM<T>::mapIndex(const std::function<T(long,T)> &f) {
+    DM<T> result(*this);
+    result.mapIndexInPlace(f);
+
+    return result;
+}
+
+template<typename T>
+msl::DM<T> msl::DM<T>::mapIndex2(const std::function<T(int,int,T)> &f) {
+    DM<T> result(*this);
+    result.mapIndexInPlace2(f);
+
+    return result;
+}
+
+template<typename T>
+void msl::DM<T>::mapTo(const std::function<T(T)> &f, DM<T>& out) {
+    if (prepareDestination(out)) {
+        out.mapInPlace(f);
     }
 }
 
 template<typename T>
-void msl::DM<T>::mapIndexInPlace(const std::function<T(int,T)> &f) {
+void msl::DM<T>::mapIndexTo(const std::function<T(long,T)> &f, DM<T>& out) {
+    if (prepareDestination(out)) {
+        out.mapIndexInPlace(f);
+    }
+}
 
-  // all necessary calculations are performed otherwise some are skipped.
-  #pragma acc parallel loop
-  for (int k = 0; k < nCPU; k++) {
-    int globalindex = k + firstIndex;
-    localPartition[k] = f(globalindex, localPartition[k]);
-  }
+template<typename T>
+void msl::DM<T>::mapIndex2To(const std::function<T(int,int,T)> &f, DM<T>& out) {
+    if (prepareDestination(out)) {
+        out.mapIndexInPlace2(f);
+    }
 }
 
+//****************************** Native Maps *******************************
 template<typename T>
-void msl::DM<T>::mapIndexInPlace2(const std::function<T(int,int,T)> &f) {
+void msl::DM<T>::mapInPlace(T (*f)(T)) {
+    pipeline.push([f](T* block, int count, long first) {
+        for (int k = 0; k < count; k++) {
+            block[k] = f(block[k]);
+        }
+    }, true, detail::Pipeline<T>::FINE_BLOCK);
+    finishMap();
+}
 
-  // all necessary calculations are performed otherwise some are skipped.
-  #pragma acc parallel loop
-  for (int k = 0; k < nCPU; k++) {
-    int row = (k + firstIndex) / ncol;
-    int col = (k + firstIndex) % ncol;
-    localPartition[k] = f(row, col, localPartition[k]);
-  }
+template<typename T>
+void msl::DM<T>::mapIndexInPlace(T (*f)(long,T)) {
+    pipeline.push([f](T* block, int count, long first) {
+        for (int k = 0; k < count; k++) {
+            block[k] = f(first + k, block[k]);
+        }
+    }, true, detail::Pipeline<T>::FINE_BLOCK);
+    finishMap();
 }
 
 template<typename T>
-void msl::DM<T>::mapIndexInPlaceM(const std::function<T(int,int,T)> &f) {
+void msl::DM<T>::mapIndexInPlace2(T (*f)(int,int,T)) {
+    int cols = ncol;
+    pipeline.push([f, cols](T* block, int count, long first) {
+        for (int k = 0; k < count; k++) {
+            int row = (first + k) / cols;
+            int col = (first + k) % cols;
+            block[k] = f(row, col, block[k]);
+        }
+    }, true, detail::Pipeline<T>::FINE_BLOCK);
+    finishMap();
+}
 
-  // all necessary calculations are performed otherwise some are skipped.
-  #pragma acc parallel loop
-  for (int k = 0; k < nCPU; k++) {
-    int row = (k + firstIndex) / ncol;
-    int col = (k + firstIndex) % ncol;
-    localPartition[k] = f(row, col, localPartition[k]);
-  }
+template<typename T>
+void msl::DM<T>::mapIndexInPlaceM(T (*f)(int,int,T)) {
+    mapIndexInPlace2(f);
 }
 
 template<typename T>
-msl::DM<T> msl::DM<T>::map(const std::function<T(T)> &f) {
-    DM<T> result(nrow, ncol);
+msl::DM<T> msl::DM<T>::map(T (*f)(T)) {
+    DM<T> result(*this);
+    result.mapInPlace(f);
+
+    return result;
+}
+
+template<typename T>
+msl::DM<T> msl::DM<T>::mapIndex(T (*f)(long,T)) {
+    DM<T> result(*this);
+    result.mapIndexInPlace(f);
+
+    return result;
+}
+
+template<typename T>
+msl::DM<T> msl::DM<T>::mapIndex2(T (*f)(int,int,T)) {
+    DM<T> result(*this);
+    result.mapIndexInPlace2(f);
+
+    return result;
+}
+
+template<typename T>
+void msl::DM<T>::mapTo(T (*f)(T), DM<T>& out) {
+    if (prepareDestination(out)) {
+        out.mapInPlace(f);
+    }
+}
+
+template<typename T>
+void msl::DM<T>::mapIndexTo(T (*f)(long,T), DM<T>& out) {
+    if (prepareDestination(out)) {
+        out.mapIndexInPlace(f);
+    }
+}
+
+template<typename T>
+void msl::DM<T>::mapIndex2To(T (*f)(int,int,T), DM<T>& out) {
+    if (prepareDestination(out)) {
+        out.mapIndexInPlace2(f);
+    }
+}
+
+//************************ Dynamically Balanced Maps *************************
+template<typename T>
+int msl::DM<T>::ownerOf(long index) const {
+    return detail::partitionOwner(n, np, index);
+}
+
+template<typename T>
+long msl::DM<T>::firstIndexOf(int rank) const {
+    return detail::partitionStart(n, np, rank);
+}
+
+template<typename T>
+void msl::DM<T>::mapDynamic(const typename detail::Pipeline<T>::Stage& stage) {
+    prepareWrite();
+    long chunkRows = std::max(1, nrow / (np * DEFAULT_CHUNKS_PER_PROC));
+    // a chunk is passed to the stage with an int count
+    long chunk = std::max(1L, std::min(chunkRows * ncol, (long) INT_MAX));
+    std::vector<T> block(chunk);
 
-    #pragma acc parallel loop
-    for (int k = 0; k < nCPU; k++){
-        result.setLocal(k, f(localPartition[k]));
+    detail::SharedCounter counter;
+    detail::Window<T> window(localPartition, nLocal);
+    for (long c = counter.next(); c * chunk < n; c = counter.next()) {
+        long first = c * chunk;
+        int count = (int) std::min((long) chunk, n - first);
+        // a chunk may span the partitions of several processes
+        for (long g = first; g < first + count; ) {
+            int owner = ownerOf(g);
+            long end = std::min(first + count, firstIndexOf(owner + 1));
+            window.get(block.data() + (g - first), owner, (int) (g - firstIndexOf(owner)), (int) (end - g));
+            g = end;
+        }
+        stage(block.data(), count, first);
+        for (long g = first; g < first + count; ) {
+            int owner = ownerOf(g);
+            long end = std::min(first + count, firstIndexOf(owner + 1));
+            window.put(block.data() + (g - first), owner, (int) (g - firstIndexOf(owner)), (int) (end - g));
+            g = end;
+        }
     }
+}
+
+template<typename T>
+void msl::DM<T>::mapIndexInPlaceMDynamic(const std::function<T(int,int,T)> &f) {
+    int cols = ncol;
+    mapDynamic([f, cols](T* block, int count, long first) {
+        for (int k = 0; k < count; k++) {
+            block[k] = f((first + k) / cols, (first + k) % cols, block[k]);
+        }
+    });
+}
+
+template<typename T>
+void msl::DM<T>::mapIndexInPlaceMDynamic(T (*f)(int,int,T)) {
+    int cols = ncol;
+    mapDynamic([f, cols](T* block, int count, long first) {
+        parallelFor(count, detail::Pipeline<T>::FINE_BLOCK, [f, cols, block, first](int begin, int end) {
+            for (int k = begin; k < end; k++) {
+                block[k] = f((first + k) / cols, (first + k) % cols, block[k]);
+            }
+        });
+    });
+}
+
+template<typename T>
+msl::DM<T> msl::DM<T>::mapIndex2Dynamic(const std::function<T(int,int,T)> &f) {
+    DM<T> result(*this);
+    result.mapIndexInPlaceMDynamic(f);
 
     return result;
 }
 
 template<typename T>
-msl::DM<T> msl::DM<T>::mapIndex(const std::function<T(int,T)> &f) {
-    DM<T> result(nrow, ncol);
+msl::DM<T> msl::DM<T>::mapIndex2Dynamic(T (*f)(int,int,T)) {
+    DM<T> result(*this);
+    result.mapIndexInPlaceMDynamic(f);
+
+    return result;
+}
 
-    #pragma acc parallel loop
-    for (int k = 0; k < nCPU; k++){
-      int globalindex = k + firstIndex;
-      result.setLocal(k, f(globalindex, localPartition[k]));
+//**************************** Expression Maps *****************************
+template<typename T>
+void msl::DM<T>::mapInPlaceExpr(const std::string& expr) {
+    Expression e(expr, matrixVariables());
+    if (!e.isValid()) {
+        return;
     }
+    int cols = ncol;
+    pipeline.push([e, cols](T* block, int count, long first) {
+        evaluateExpression(e, block, block, count, first, cols);
+    }, true);
+    finishMap();
+}
+
+template<typename T>
+msl::DM<T> msl::DM<T>::mapExpr(const std::string& expr) {
+    DM<T> result(*this);
+    result.mapInPlaceExpr(expr);
 
     return result;
 }
 
+//**************************** Compiled Kernels ****************************
 template<typename T>
-msl::DM<T> msl::DM<T>::mapIndex2(const std::function<T(int,int,T)> &f) {
-    DM<T> result(nrow, ncol);
+void msl::DM<T>::mapInPlaceKernel(const std::string& body, const std::vector<double>& params) {
+    Kernel kernel = Kernel::create<T>(body);
+    if (!kernel.isValid()) {
+        return;
+    }
+    int cols = ncol;
+    pipeline.push([kernel, params, cols](T* block, int count, long first) {
+        kernel.run(block, block, count, first, cols, params);
+    }, true, detail::Pipeline<T>::FINE_BLOCK);
+    finishMap();
+}
+
+template<typename T>
+msl::DM<T> msl::DM<T>::mapKernel(const std::string& body, const std::vector<double>& params) {
+    DM<T> result(*this);
+    result.mapInPlaceKernel(body, params);
 
-    #pragma acc parallel loop
-    for (int k = 0; k < nCPU; k++){
-      int row = (k + firstIndex) / ncol;
-      int col = (k + firstIndex) % ncol;
-      result.setLocal(k, f(row, col, localPartition[k]));
+    return result;
+}
+
+//*********************************** Zips ***********************************
+template<typename T>
+void msl::DM<T>::zipInPlace(DM<T>& b, const std::function<T(T,T)> &f) {
+    if (b.nrow != nrow || b.ncol != ncol) {
+        throws(detail::IllegalPartitionException());
+        return;
     }
+    // the stage reads the current local partition of b, even if b changes later
+    b.evaluate();
+    std::shared_ptr<T> other = b.buffer;
+    long offset = firstIndex;
+    pipeline.push([f, other, offset](T* block, int count, long first) {
+        const T* in = other.get() + (first - offset);
+        for (int k = 0; k < count; k++) {
+            block[k] = f(block[k], in[k]);
+        }
+    }, false);
+    finishMap();
+}
+
+template<typename T>
+msl::DM<T> msl::DM<T>::zip(DM<T>& b, const std::function<T(T,T)> &f) {
+    DM<T> result(*this);
+    result.zipInPlace(b, f);
 
     return result;
 }
 
+//******************************* Batched Maps *******************************
+template<typename T>
+void msl::DM<T>::mapInPlaceBatch(const std::function<detail::BatchArray<T>(py::array_t<T>)> &f) {
+    prepareWrite();
+    int batch = detail::batchSize(nCPU);
+    for (int k = 0; k < nCPU; k += batch) {
+        int count = std::min(batch, nCPU - k);
+        detail::batchStore(f(detail::batchView(localPartition + k, count)), localPartition + k, count);
+    }
+}
+
+template<typename T>
+void msl::DM<T>::mapIndexInPlaceBatch(const std::function<detail::BatchArray<T>(py::array_t<long>, py::array_t<T>)> &f) {
+    prepareWrite();
+    int batch = detail::batchSize(nCPU);
+    for (int k = 0; k < nCPU; k += batch) {
+        int count = std::min(batch, nCPU - k);
+        py::array_t<long> indices = detail::batchIndices(k + firstIndex, count);
+        detail::batchStore(f(indices, detail::batchView(localPartition + k, count)), localPartition + k, count);
+    }
+}
+
+template<typename T>
+void msl::DM<T>::mapIndexInPlace2Batch(const std::function<detail::BatchArray<T>(py::array_t<int>, py::array_t<int>, py::array_t<T>)> &f) {
+    prepareWrite();
+    int batch = detail::batchSize(nCPU);
+    py::array_t<int> rows, cols;
+    for (int k = 0; k < nCPU; k += batch) {
+        int count = std::min(batch, nCPU - k);
+        detail::batchRowsCols(k + firstIndex, count, ncol, rows, cols);
+        detail::batchStore(f(rows, cols, detail::batchView(localPartition + k, count)), localPartition + k, count);
+    }
+}
+
+template<typename T>
+msl::DM<T> msl::DM<T>::mapBatch(const std::function<detail::BatchArray<T>(py::array_t<T>)> &f) {
+    DM<T> result(*this);
+    result.mapInPlaceBatch(f);
+
+    return result;
+}
+
+template<typename T>
+msl::DM<T> msl::DM<T>::mapIndexBatch(const std::function<detail::BatchArray<T>(py::array_t<long>, py::array_t<T>)> &f) {
+    DM<T> result(*this);
+    result.mapIndexInPlaceBatch(f);
+
+    return result;
+}
+
+template<typename T>
+msl::DM<T> msl::DM<T>::mapIndex2Batch(const std::function<detail::BatchArray<T>(py::array_t<int>, py::array_t<int>, py::array_t<T>)> &f) {
+    DM<T> result(*this);
+    result.mapIndexInPlace2Batch(f);
+
+    return result;
+}
+
+
+//************************** Maps of Distinct Values **************************
+template<typename T>
+void msl::DM<T>::mapInPlaceUnique(const std::function<T(T)> &f) {
+    prepareWrite();
+    std::vector<T> values;
+    std::vector<int> codes;
+    detail::uniqueValues(localPartition, nCPU, values, codes);
+    for (T& value : values) {
+        value = f(value);
+    }
+    T* out = localPartition;
+    const T* results = values.data();
+    const int* in = codes.data();
+    parallelFor(nCPU, ThreadPool::GRAIN, [out, results, in](int begin, int end) {
+        for (int k = begin; k < end; k++) {
+            out[k] = results[in[k]];
+        }
+    });
+}
+
+template<typename T>
+msl::DM<T> msl::DM<T>::mapUnique(const std::function<T(T)> &f) {
+    DM<T> result(*this);
+    result.mapInPlaceUnique(f);
+
+    return result;
+}
+
+//************************** Native Operator Maps ****************************
+template<typename T>
+void msl::DM<T>::mapInPlaceOp(Operator op, const T& a, const T& b) {
+    if (!checkOperator(op, a, b)) {
+        return;
+    }
+    pipeline.push([op, a, b](T* block, int count, long first) {
+        applyOperator(op, block, block, count, a, b);
+    }, true);
+    finishMap();
+}
+
+template<typename T>
+void msl::DM<T>::mapInPlaceOp(const std::string& name, const T& a, const T& b) {
+    Operator op;
+    if (parseOperator(name, op)) {
+        mapInPlaceOp(op, a, b);
+    }
+}
+
+template<typename T>
+msl::DM<T> msl::DM<T>::mapOp(Operator op, const T& a, const T& b) {
+    DM<T> result(*this);
+    result.mapInPlaceOp(op, a, b);
+
+    return result;
+}
+
+template<typename T>
+msl::DM<T> msl::DM<T>::mapOp(const std::string& name, const T& a, const T& b) {
+    Operator op;
+    if (!parseOperator(name, op)) {
+        return DM<T>(*this);
+    }
+    return mapOp(op, a, b);
+}
+
+template<typename T>
+template<typename R>
+msl::DM<R> msl::DM<T>::mapCast() {
+    DM<R> result(nrow, ncol);
+    R* out = result.localPartition;
+    evaluate();
+    const T* in = localPartition;
+    parallelFor(nCPU, ThreadPool::GRAIN, [in, out](int begin, int end) {
+        for (int k = begin; k < end; k++) {
+            out[k] = static_cast<R>(in[k]);
+        }
+    });
+
+    return result;
+}
+
+namespace {
+
+// binds the members of DM<T> that use native functions or ordered arithmetic
+template<typename T>
+void bindArithmetic(py::class_<msl::DM<T>>& c) {
+    typedef msl::DM<T> DM;
+    c.def("mapInPlace", msl::detail::nativeOrPython<T(T)>(&DM::mapInPlace, &DM::mapInPlace))
+     .def("mapIndexInPlace", msl::detail::nativeOrPython<T(long,T)>(&DM::mapIndexInPlace, &DM::mapIndexInPlace))
+     .def("mapIndexInPlace2", msl::detail::nativeOrPython<T(int,int,T)>(&DM::mapIndexInPlace2, &DM::mapIndexInPlace2))
+     .def("mapIndexInPlaceM", msl::detail::nativeOrPython<T(int,int,T)>(&DM::mapIndexInPlaceM, &DM::mapIndexInPlaceM))
+     .def("map", msl::detail::nativeOrPython<T(T)>(&DM::map, &DM::map))
+     .def("mapIndex", msl::detail::nativeOrPython<T(long,T)>(&DM::mapIndex, &DM::mapIndex))
+     .def("mapIndex2", msl::detail::nativeOrPython<T(int,int,T)>(&DM::mapIndex2, &DM::mapIndex2))
+     .def("mapTo", msl::detail::nativeOrPython<T(T)>(&DM::mapTo, &DM::mapTo))
+     .def("mapIndexTo", msl::detail::nativeOrPython<T(long,T)>(&DM::mapIndexTo, &DM::mapIndexTo))
+     .def("mapIndex2To", msl::detail::nativeOrPython<T(int,int,T)>(&DM::mapIndex2To, &DM::mapIndex2To))
+     .def("mapIndexInPlaceMDynamic", msl::detail::nativeOrPython<T(int,int,T)>(&DM::mapIndexInPlaceMDynamic, &DM::mapIndexInPlaceMDynamic))
+     .def("mapIndex2Dynamic", msl::detail::nativeOrPython<T(int,int,T)>(&DM::mapIndex2Dynamic, &DM::mapIndex2Dynamic))
+     .def("mapInPlaceKernel", &DM::mapInPlaceKernel, py::arg("body"), py::arg("params") = std::vector<double>(),
+          py::call_guard<py::gil_scoped_release>())
+     .def("mapKernel", &DM::mapKernel, py::arg("body"), py::arg("params") = std::vector<double>(),
+          py::call_guard<py::gil_scoped_release>())
+     .def("mapInPlaceUnique", &DM::mapInPlaceUnique)
+     .def("mapUnique", &DM::mapUnique)
+     .def("mapInPlaceExpr", &DM::mapInPlaceExpr, py::call_guard<py::gil_scoped_release>())
+     .def("mapExpr", &DM::mapExpr, py::call_guard<py::gil_scoped_release>())
+     .def("mapInPlaceOp", py::overload_cast<msl::Operator, const T&, const T&>(&DM::mapInPlaceOp),
+          py::arg("op"), py::arg("a") = 0, py::arg("b") = 0, py::call_guard<py::gil_scoped_release>())
+     .def("mapInPlaceOp", py::overload_cast<const std::string&, const T&, const T&>(&DM::mapInPlaceOp),
+          py::arg("op"), py::arg("a") = 0, py::arg("b") = 0, py::call_guard<py::gil_scoped_release>())
+     .def("mapOp", py::overload_cast<msl::Operator, const T&, const T&>(&DM::mapOp),
+          py::arg("op"), py::arg("a") = 0, py::arg("b") = 0, py::call_guard<py::gil_scoped_release>())
+     .def("mapOp", py::overload_cast<const std::string&, const T&, const T&>(&DM::mapOp),
+          py::arg("op"), py::arg("a") = 0, py::arg("b") = 0, py::call_guard<py::gil_scoped_release>())
+     .def("toInt", &DM::template mapCast<int>, py::call_guard<py::gil_scoped_release>())
+     .def("toFloat", &DM::template mapCast<float>, py::call_guard<py::gil_scoped_release>())
+     .def("toDouble", &DM::template mapCast<double>, py::call_guard<py::gil_scoped_release>());
+}
+
+// binds the maps of DM<T> for element types without native functions
+template<typename T>
+void bindPython(py::class_<msl::DM<T>>& c) {
+    typedef msl::DM<T> DM;
+    c.def("mapInPlace", py::overload_cast<const std::function<T(T)>&>(&DM::mapInPlace))
+     .def("mapIndexInPlace", py::overload_cast<const std::function<T(long,T)>&>(&DM::mapIndexInPlace))
+     .def("mapIndexInPlace2", py::overload_cast<const std::function<T(int,int,T)>&>(&DM::mapIndexInPlace2))
+     .def("mapIndexInPlaceM", py::overload_cast<const std::function<T(int,int,T)>&>(&DM::mapIndexInPlaceM))
+     .def("map", py::overload_cast<const std::function<T(T)>&>(&DM::map))
+     .def("mapIndex", py::overload_cast<const std::function<T(long,T)>&>(&DM::mapIndex))
+     .def("mapIndex2", py::overload_cast<const std::function<T(int,int,T)>&>(&DM::mapIndex2))
+     .def("mapTo", py::overload_cast<const std::function<T(T)>&, DM&>(&DM::mapTo))
+     .def("mapIndexTo", py::overload_cast<const std::function<T(long,T)>&, DM&>(&DM::mapIndexTo))
+     .def("mapIndex2To", py::overload_cast<const std::function<T(int,int,T)>&, DM&>(&DM::mapIndex2To))
+     .def("mapIndexInPlaceMDynamic", py::overload_cast<const std::function<T(int,int,T)>&>(&DM::mapIndexInPlaceMDynamic))
+     .def("mapIndex2Dynamic", py::overload_cast<const std::function<T(int,int,T)>&>(&DM::mapIndex2Dynamic));
+}
+
+// binds DM<T> as <name>DM (and <alias>DM)
+template<typename T>
+void bindDM(py::module& m) {
+    typedef msl::DM<T> DM;
+    std::string name = std::string(msl::detail::ElementName<T>::name()) + "DM";
+    py::class_<DM> c(m, name.c_str());
+    c.def(py::init())
+     .def(py::init<int, int>())
+     .def(py::init<int, int, T>())
+     .def(py::init<int, int, const std::string&, bool>(), py::arg("row"), py::arg("col"), py::arg("path"), py::arg("perRank") = false)
+     .def("fill", &DM::fill)
+     .def("mapInPlaceBatch", &DM::mapInPlaceBatch)
+     .def("mapIndexInPlaceBatch", &DM::mapIndexInPlaceBatch)
+     .def("mapIndexInPlace2Batch", &DM::mapIndexInPlace2Batch)
+     .def("mapBatch", &DM::mapBatch)
+     .def("mapIndexBatch", &DM::mapIndexBatch)
+     .def("mapIndex2Batch", &DM::mapIndex2Batch)
+     .def("zipInPlace", &DM::zipInPlace)
+     .def("zip", &DM::zip)
+     .def("evaluate", &DM::evaluate)
+     .def("flush", &DM::flush)
+     .def("getLocalPartition", &DM::getLocalPartition)
+     .def("setLocalPartition", &DM::setLocalPartition)
+     .def("adoptLocalPartition", &DM::adoptLocalPartition)
+     .def("setHugePages", &DM::setHugePages)
+     .def("setMatrix", &DM::setMatrix)
+     .def("scatterFrom", &DM::scatterFrom, py::arg("root"), py::arg("array") = py::none())
+     .def("getRows", &DM::getRows)
+     .def("getCols", &DM::getCols)
+     .def("get", &DM::get)
+     .def("getMany", &DM::getMany)
+     .def("getRange", &DM::getRange)
+     .def("set", &DM::set)
+     .def("remoteGet", &DM::remoteGet)
+     .def("remotePut", &DM::remotePut)
+     .def("accumulate", &DM::accumulate, py::arg("index"), py::arg("v"), py::arg("op") = msl::Operator::ADD)
+     .def("showLocal", &DM::showLocal)
+     .def("show", &DM::show)
+     .def("getSize", &DM::getSize)
+     .def("getLocalSize", &DM::getLocalSize)
+     .def("getFirstIndex", &DM::getFirstIndex)
+     .def("isLocal", &DM::isLocal)
+     .def("getLocal", &DM::getLocal)
+     .def("setLocal", &DM::setLocal)
+     .def("gather", &DM::gather, py::arg("root") = 0)
+     .def("gatherAll", &DM::gatherAll)
+     .def("gatherRegion", &DM::gatherRegion, py::arg("r0"), py::arg("r1"), py::arg("c0"), py::arg("c1"),
+          py::arg("root") = 0);
+    if constexpr (msl::detail::HasArithmetic<T>::value) {
+        bindArithmetic<T>(c);
+    } else {
+        bindPython<T>(c);
+    }
+    if (msl::detail::ElementName<T>::alias() != nullptr) {
+        m.attr((std::string(msl::detail::ElementName<T>::alias()) + "DM").c_str()) = c;
+    }
+}
+
+// creates a DM<T> holding the elements of the two-dimensional array if its dtype is T
+template<typename T>
+bool fromArray(const py::array& array, py::object& result) {
+    if (!py::isinstance<py::array_t<T>>(array)) {
+        return false;
+    }
+    if (array.ndim() != 2) {
+        msl::throws(msl::detail::IllegalArrayException("expected a two-dimensional array"));
+        return true;
+    }
+    if (array.shape(0) > INT_MAX || array.shape(1) > INT_MAX) {
+        msl::throws(msl::detail::IllegalArrayException("more than INT_MAX rows or columns"));
+        return true;
+    }
+    msl::DM<T> dm((int) array.shape(0), (int) array.shape(1));
+    dm.setMatrix(py::reinterpret_borrow<py::array_t<T>>(array));
+    result = py::cast(std::move(dm));
+    return true;
+}
+
+template<typename... Ts>
+void bindAll(py::module& m, msl::detail::TypeList<Ts...>) {
+    (bindDM<Ts>(m), ...);
+}
+
+template<typename... Ts>
+py::object fromAnyArray(const py::array& array, msl::detail::TypeList<Ts...>) {
+    py::object result = py::none();
+    if (!(fromArray<Ts>(array, result) || ...)) {
+        msl::throws(msl::detail::IllegalArrayException("unsupported dtype " + std::string(py::str(array.dtype()))));
+    }
+    return result;
+}
+
+}
 
 void bind_dm(py::module& m) {
-    py::class_<msl::DM<int>>(m, "intDM")
-        .def(py::init())
-        .def(py::init<int, int>())
-        .def(py::init<int, int, int>())
-        .def("fill", &msl::DM<int>::fill)
-        .def("mapInPlace", &msl::DM<int>::mapInPlace)
-        .def("mapIndexInPlace", &msl::DM<int>::mapIndexInPlace)
-        .def("mapIndexInPlace2", &msl::DM<int>::mapIndexInPlace2)
-//        .def("mapIndexInPlace", py::overload_cast<const std::function<int(int,int)> &>(&msl::DM<int>::mapIndexInPlace))
-//        .def("mapIndexInPlace", py::overload_cast<const std::function<int(int,int,int)> &>(&msl::DM<int>::mapIndexInPlace))
-        .def("mapIndexInPlaceM", &msl::DM<int>::mapIndexInPlaceM)
-        .def("map", &msl::DM<int>::map)
-        .def("mapIndex", &msl::DM<int>::mapIndex)
-        .def("mapIndex2", &msl::DM<int>::mapIndex2)
-//        .def("mapIndex", py::overload_cast<const std::function<int(int,int)> &>(&msl::DM<int>::mapIndex))
-//        .def("mapIndex", py::overload_cast<const std::function<int(int,int,int)> &>(&msl::DM<int>::mapIndex))
-//        .def("mapIndex",[](py::function &f) {
-//              py::print(py::detail::get_function(f));
-//              pybind11::module inspect_module = pybind11::module::import("inspect");
-//              pybind11::object result = inspect_module.attr("signature")(f).attr("parameters");
-//              auto num_params = pybind11::len(result);
-//              msl::DM<int> dm;
-//              if (num_params == 2)
-//              {
-//                  return dm.mapIndex(py::cast<const std::function<int(int,int)> >(f));
-//              }
-//              else if (num_params == 3)
-//              {
-//                  return dm.mapIndex(py::cast<const std::function<int(int,int,int)> >(f));
-//              }
-//          })
-        .def("getLocalPartition", &msl::DM<int>::getLocalPartition)
-        .def("setLocalPartition", &msl::DM<int>::setLocalPartition)
-        .def("setMatrix", &msl::DM<int>::setMatrix)
-        .def("getRows", &msl::DM<int>::getRows)
-        .def("getCols", &msl::DM<int>::getCols)
-        .def("get", &msl::DM<int>::get)
-        .def("set", &msl::DM<int>::set)
-        .def("showLocal", &msl::DM<int>::showLocal)
-        .def("show", &msl::DM<int>::show)
-        .def("getSize", &msl::DM<int>::getSize)
-        .def("getLocalSize", &msl::DM<int>::getLocalSize)
-        .def("getFirstIndex", &msl::DM<int>::getFirstIndex)
-        .def("isLocal", &msl::DM<int>::isLocal)
-        .def("getLocal", &msl::DM<int>::getLocal)
-        .def("setLocal", &msl::DM<int>::setLocal)
-        .def("gather", &msl::DM<int>::gather)
-    ;
+    // structured NumPy dtype for views of DM<Pixel>
+    PYBIND11_NUMPY_DTYPE(Pixel, r, g, b);
+
+    bindAll(m, msl::detail::ElementTypes());
     py::class_<msl::DM<Pixel>>(m, "Mandelbrot")
         .def(py::init<int, int, Pixel>())
         .def("getRows", &msl::DM<Pixel>::getRows)
         .def("getCols", &msl::DM<Pixel>::getCols)
         .def("get", &msl::DM<Pixel>::get)
-        .def("mapIndexInPlaceM", &msl::DM<Pixel>::mapIndexInPlaceM)
-    ;
-    py::class_<msl::DM<float>>(m, "floatDM")
-        .def(py::init<int, int, float>())
-        .def("getRows", &msl::DM<float>::getRows)
-        .def("getCols", &msl::DM<float>::getCols)
-        .def("get", &msl::DM<float>::get)
-        .def("mapIndexInPlace", &msl::DM<float>::mapIndexInPlace)
-        .def("mapIndexInPlace2", &msl::DM<float>::mapIndexInPlace2)
-//        .def("mapIndexInPlace", py::overload_cast<const std::function<float(int,float)> &>(&msl::DM<float>::mapIndexInPlace))
-//        .def("mapIndexInPlace", py::overload_cast<const std::function<float(int,int,float)> &>(&msl::DM<float>::mapIndexInPlace))
-        .def("mapIndexInPlaceM", &msl::DM<float>::mapIndexInPlaceM)
+        .def("getMany", &msl::DM<Pixel>::getMany)
+        .def("getRange", &msl::DM<Pixel>::getRange)
+        .def("gather", &msl::DM<Pixel>::gather, py::arg("root") = 0)
+        .def("gatherRegion", &msl::DM<Pixel>::gatherRegion, py::arg("r0"), py::arg("r1"), py::arg("c0"),
+             py::arg("c1"), py::arg("root") = 0)
+        .def("remoteGet", &msl::DM<Pixel>::remoteGet)
+        .def("remotePut", &msl::DM<Pixel>::remotePut)
+        .def("getLocalPartition", &msl::DM<Pixel>::getLocalPartition)
+        .def("mapIndexInPlaceM", py::overload_cast<const std::function<Pixel(int,int,Pixel)>&>(&msl::DM<Pixel>::mapIndexInPlaceM))
+        .def("mapIndexInPlaceMDynamic", py::overload_cast<const std::function<Pixel(int,int,Pixel)>&>(&msl::DM<Pixel>::mapIndexInPlaceMDynamic))
+        .def("mapInPlaceKernel", &msl::DM<Pixel>::mapInPlaceKernel, py::arg("body"), py::arg("params") = std::vector<double>(),
+             py::call_guard<py::gil_scoped_release>())
     ;
     py::class_<Pixel>(m, "Pixel")
         .def(py::init<>())
@@ -415,4 +1341,8 @@ void bind_dm(py::module& m) {
         .def_readwrite("g", &Pixel::g)
         .def_readwrite("b", &Pixel::b)
     ;
+    // the element type follows the dtype of the array, e.g. int64DM for int64
+    m.def("DM", [](const py::array& array) {
+        return fromAnyArray(array, msl::detail::ElementTypes());
+    }, py::arg("array"));
 }
@@ -0,0 +1,471 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include "../include/muesli.h"
+#include "../include/expression.h"
+
+namespace {
+
+// Error inside the parser; reported by the constructor of Expression.
+struct ParseError
+{
+  std::string message;
+};
+
+enum OperandKind { VARIABLE, CONSTANT, TEMPORARY };
+
+struct Operand
+{
+  OperandKind kind;
+  int index;
+};
+
+struct PendingInstruction
+{
+  msl::Expression::OpCode op;
+  Operand dst, a, b, c;
+};
+
+struct FunctionInfo
+{
+  const char* name;
+  int arity;
+  msl::Expression::OpCode op;
+};
+
+const FunctionInfo functions[] = {
+  {"abs", 1, msl::Expression::ABS},
+  {"sqrt", 1, msl::Expression::SQRT},
+  {"exp", 1, msl::Expression::EXP},
+  {"log", 1, msl::Expression::LOG},
+  {"sin", 1, msl::Expression::SIN},
+  {"cos", 1, msl::Expression::COS},
+  {"tan", 1, msl::Expression::TAN},
+  {"floor", 1, msl::Expression::FLOOR},
+  {"ceil", 1, msl::Expression::CEIL},
+  {"min", 2, msl::Expression::MIN},
+  {"max", 2, msl::Expression::MAX},
+  {"pow", 2, msl::Expression::POW},
+  {"where", 3, msl::Expression::SELECT},
+};
+
+double apply(msl::Expression::OpCode op, double a, double b, double c)
+{
+  switch (op) {
+  case msl::Expression::ADD: return a + b;
+  case msl::Expression::SUB: return a - b;
+  case msl::Expression::MUL: return a * b;
+  case msl::Expression::DIV: return a / b;
+  case msl::Expression::MOD: return std::fmod(a, b);
+  case msl::Expression::POW: return std::pow(a, b);
+  case msl::Expression::MIN: return a < b ? a : b;
+  case msl::Expression::MAX: return a > b ? a : b;
+  case msl::Expression::LT: return a < b;
+  case msl::Expression::LE: return a <= b;
+  case msl::Expression::GT: return a > b;
+  case msl::Expression::GE: return a >= b;
+  case msl::Expression::EQ: return a == b;
+  case msl::Expression::NE: return a != b;
+  case msl::Expression::AND: return a != 0.0 && b != 0.0;
+  case msl::Expression::OR: return a != 0.0 || b != 0.0;
+  case msl::Expression::NEG: return -a;
+  case msl::Expression::NOT: return a == 0.0;
+  case msl::Expression::ABS: return std::fabs(a);
+  case msl::Expression::SQRT: return std::sqrt(a);
+  case msl::Expression::EXP: return std::exp(a);
+  case msl::Expression::LOG: return std::log(a);
+  case msl::Expression::SIN: return std::sin(a);
+  case msl::Expression::COS: return std::cos(a);
+  case msl::Expression::TAN: return std::tan(a);
+  case msl::Expression::FLOOR: return std::floor(a);
+  case msl::Expression::CEIL: return std::ceil(a);
+  case msl::Expression::SELECT: return a != 0.0 ? b : c;
+  }
+  return 0.0;
+}
+
+}
+
+// Recursive descent parser emitting bytecode. Temporary registers are
+// recycled as soon as their value has been consumed.
+class msl::Expression::Parser
+{
+public:
+  Parser(const std::string& s, const std::vector<std::string>& v)
+    : source(s), variables(v), pos(0), numTemporaries(0)
+  {
+  }
+
+  Operand parse()
+  {
+    Operand result = ternary();
+    skipSpace();
+    if (pos < source.size()) {
+      error("unexpected '" + source.substr(pos, 1) + "'");
+    }
+    return result;
+  }
+
+  const std::string& source;
+  const std::vector<std::string>& variables;
+  size_t pos;
+  std::vector<double> constants;
+  std::vector<PendingInstruction> code;
+  std::vector<int> freeTemporaries;
+  int numTemporaries;
+
+private:
+  void error(const std::string& message)
+  {
+    throw ParseError{message + " at position " + std::to_string(pos) + " in \"" + source + "\""};
+  }
+
+  void skipSpace()
+  {
+    while (pos < source.size() && std::isspace((unsigned char) source[pos])) {
+      pos++;
+    }
+  }
+
+  // consumes the token t if it comes next
+  bool accept(const char* t)
+  {
+    skipSpace();
+    size_t len = std::char_traits<char>::length(t);
+    if (source.compare(pos, len, t) != 0) {
+      return false;
+    }
+    // do not split "**", "<=", ... into single characters
+    if (len == 1 && pos + 1 < source.size()) {
+      char next = source[pos + 1];
+      if ((t[0] == '*' && next == '*') || ((t[0] == '<' || t[0] == '>' || t[0] == '!' || t[0] == '=') && next == '=')) {
+        return false;
+      }
+    }
+    pos += len;
+    return true;
+  }
+
+  void expect(const char* t)
+  {
+    if (!accept(t)) {
+      error(std::string("expected '") + t + "'");
+    }
+  }
+
+  Operand constant(double value)
+  {
+    constants.push_back(value);
+    return Operand{CONSTANT, (int) constants.size() - 1};
+  }
+
+  void release(const Operand& o)
+  {
+    if (o.kind == TEMPORARY) {
+      freeTemporaries.push_back(o.index);
+    }
+  }
+
+  Operand temporary()
+  {
+    if (!freeTemporaries.empty()) {
+      int t = freeTemporaries.back();
+      freeTemporaries.pop_back();
+      return Operand{TEMPORARY, t};
+    }
+    return Operand{TEMPORARY, numTemporaries++};
+  }
+
+  // emits op(a, b, c), folding it if all operands are constants
+  Operand emit(OpCode op, Operand a, Operand b, Operand c, int arity)
+  {
+    bool folded = a.kind == CONSTANT && (arity < 2 || b.kind == CONSTANT) && (arity < 3 || c.kind == CONSTANT);
+    if (folded) {
+      double va = constants[a.index];
+      double vb = arity >= 2 ? constants[b.index] : 0.0;
+      double vc = arity >= 3 ? constants[c.index] : 0.0;
+      return constant(apply(op, va, vb, vc));
+    }
+    release(a);
+    if (arity >= 2) release(b);
+    if (arity >= 3) release(c);
+    Operand dst = temporary();
+    code.push_back(PendingInstruction{op, dst, a, arity >= 2 ? b : a, arity >= 3 ? c : a});
+    return dst;
+  }
+
+  Operand emit(OpCode op, Operand a)
+  {
+    return emit(op, a, a, a, 1);
+  }
+
+  Operand emit(OpCode op, Operand a, Operand b)
+  {
+    return emit(op, a, b, a, 2);
+  }
+
+  Operand ternary()
+  {
+    Operand c = logicalOr();
+    if (accept("?")) {
+      Operand a = ternary();
+      expect(":");
+      Operand b = ternary();
+      return emit(SELECT, c, a, b, 3);
+    }
+    return c;
+  }
+
+  Operand logicalOr()
+  {
+    Operand a = logicalAnd();
+    while (accept("||")) {
+      a = emit(OR, a, logicalAnd());
+    }
+    return a;
+  }
+
+  Operand logicalAnd()
+  {
+    Operand a = comparison();
+    while (accept("&&")) {
+      a = emit(AND, a, comparison());
+    }
+    return a;
+  }
+
+  Operand comparison()
+  {
+    Operand a = sum();
+    if (accept("<=")) return emit(LE, a, sum());
+    if (accept(">=")) return emit(GE, a, sum());
+    if (accept("==")) return emit(EQ, a, sum());
+    if (accept("!=")) return emit(NE, a, sum());
+    if (accept("<")) return emit(LT, a, sum());
+    if (accept(">")) return emit(GT, a, sum());
+    return a;
+  }
+
+  Operand sum()
+  {
+    Operand a = product();
+    while (true) {
+      if (accept("+")) {
+        a = emit(ADD, a, product());
+      } else if (accept("-")) {
+        a = emit(SUB, a, product());
+      } else {
+        return a;
+      }
+    }
+  }
+
+  Operand product()
+  {
+    Operand a = unary();
+    while (true) {
+      if (accept("*")) {
+        a = emit(MUL, a, unary());
+      } else if (accept("/")) {
+        a = emit(DIV, a, unary());
+      } else if (accept("%")) {
+        a = emit(MOD, a, unary());
+      } else {
+        return a;
+      }
+    }
+  }
+
+  Operand unary()
+  {
+    if (accept("-")) {
+      return emit(NEG, unary());
+    }
+    if (accept("+")) {
+      return unary();
+    }
+    if (accept("!")) {
+      return emit(NOT, unary());
+    }
+    return power();
+  }
+
+  Operand power()
+  {
+    Operand a = primary();
+    if (accept("**") || accept("^")) {
+      return emit(POW, a, unary());
+    }
+    return a;
+  }
+
+  Operand primary()
+  {
+    skipSpace();
+    if (pos >= source.size()) {
+      error("unexpected end of expression");
+    }
+    char ch = source[pos];
+    if (accept("(")) {
+      Operand a = ternary();
+      expect(")");
+      return a;
+    }
+    if (std::isdigit((unsigned char) ch) || ch == '.') {
+      const char* begin = source.c_str() + pos;
+      char* end;
+      double value = std::strtod(begin, &end);
+      if (end == begin) {
+        error("illegal number");
+      }
+      pos += end - begin;
+      return constant(value);
+    }
+    if (std::isalpha((unsigned char) ch) || ch == '_') {
+      size_t start = pos;
+      while (pos < source.size() && (std::isalnum((unsigned char) source[pos]) || source[pos] == '_')) {
+        pos++;
+      }
+      std::string name = source.substr(start, pos - start);
+      if (accept("(")) {
+        return call(name);
+      }
+      for (size_t v = 0; v < variables.size(); v++) {
+        if (variables[v] == name) {
+          return Operand{VARIABLE, (int) v};
+        }
+      }
+      pos = start;
+      error("unknown variable '" + name + "'");
+    }
+    error(std::string("unexpected '") + ch + "'");
+    return Operand{CONSTANT, 0};
+  }
+
+  Operand call(const std::string& name)
+  {
+    for (const FunctionInfo& f : functions) {
+      if (name != f.name) {
+        continue;
+      }
+      Operand args[3];
+      for (int k = 0; k < f.arity; k++) {
+        if (k > 0) {
+          expect(",");
+        }
+        args[k] = ternary();
+      }
+      expect(")");
+      return emit(f.op, args[0], f.arity >= 2 ? args[1] : args[0], f.arity >= 3 ? args[2] : args[0], f.arity);
+    }
+    error("unknown function '" + name + "'");
+    return Operand{CONSTANT, 0};
+  }
+};
+
+msl::Expression::Expression(const std::string& source, const std::vector<std::string>& variables)
+  : numVariables((int) variables.size()), numTemporaries(0), result(0),
+    used(variables.size(), false), valid(false)
+{
+  Parser parser(source, variables);
+  Operand r;
+  try {
+    r = parser.parse();
+  } catch (const ParseError& e) {
+    throws(detail::IllegalExpressionException(e.message));
+    return;
+  }
+
+  constants = parser.constants;
+  numTemporaries = parser.numTemporaries;
+  int firstConstant = numVariables;
+  int firstTemporary = firstConstant + (int) constants.size();
+  auto reg = [&](const Operand& o) {
+    switch (o.kind) {
+    case VARIABLE:
+      used[o.index] = true;
+      return o.index;
+    case CONSTANT:
+      return firstConstant + o.index;
+    default:
+      return firstTemporary + o.index;
+    }
+  };
+
+  for (const PendingInstruction& p : parser.code) {
+    code.push_back(Instruction{p.op, reg(p.dst), reg(p.a), reg(p.b), reg(p.c)});
+  }
+  result = reg(r);
+  valid = true;
+}
+
+bool msl::Expression::isValid() const
+{
+  return valid;
+}
+
+bool msl::Expression::uses(int variable) const
+{
+  return variable < numVariables && used[variable];
+}
+
+size_t msl::Expression::workspaceSize() const
+{
+  return (constants.size() + numTemporaries) * BLOCK;
+}
+
+void msl::Expression::evaluate(const double* const* inputs, double* out, int count, double* workspace) const
+{
+  std::vector<double*> registers(numVariables + constants.size() + numTemporaries);
+  for (int v = 0; v < numVariables; v++) {
+    registers[v] = const_cast<double*>(inputs[v]);
+  }
+  for (size_t c = 0; c < constants.size(); c++) {
+    double* r = workspace + c * BLOCK;
+    std::fill(r, r + count, constants[c]);
+    registers[numVariables + c] = r;
+  }
+  for (int t = 0; t < numTemporaries; t++) {
+    registers[numVariables + constants.size() + t] = workspace + (constants.size() + t) * BLOCK;
+  }
+
+  for (const Instruction& ins : code) {
+    double* d = registers[ins.dst];
+    const double* a = registers[ins.a];
+    const double* b = registers[ins.b];
+    const double* c = registers[ins.c];
+    switch (ins.op) {
+    case ADD: for (int j = 0; j < count; j++) d[j] = a[j] + b[j]; break;
+    case SUB: for (int j = 0; j < count; j++) d[j] = a[j] - b[j]; break;
+    case MUL: for (int j = 0; j < count; j++) d[j] = a[j] * b[j]; break;
+    case DIV: for (int j = 0; j < count; j++) d[j] = a[j] / b[j]; break;
+    case MOD: for (int j = 0; j < count; j++) d[j] = std::fmod(a[j], b[j]); break;
+    case POW: for (int j = 0; j < count; j++) d[j] = std::pow(a[j], b[j]); break;
+    case MIN: for (int j = 0; j < count; j++) d[j] = a[j] < b[j] ? a[j] : b[j]; break;
+    case MAX: for (int j = 0; j < count; j++) d[j] = a[j] > b[j] ? a[j] : b[j]; break;
+    case LT: for (int j = 0; j < count; j++) d[j] = a[j] < b[j]; break;
+    case LE: for (int j = 0; j < count; j++) d[j] = a[j] <= b[j]; break;
+    case GT: for (int j = 0; j < count; j++) d[j] = a[j] > b[j]; break;
+    case GE: for (int j = 0; j < count; j++) d[j] = a[j] >= b[j]; break;
+    case EQ: for (int j = 0; j < count; j++) d[j] = a[j] == b[j]; break;
+    case NE: for (int j = 0; j < count; j++) d[j] = a[j] != b[j]; break;
+    case AND: for (int j = 0; j < count; j++) d[j] = a[j] != 0.0 && b[j] != 0.0; break;
+    case OR: for (int j = 0; j < count; j++) d[j] = a[j] != 0.0 || b[j] != 0.0; break;
+    case NEG: for (int j = 0; j < count; j++) d[j] = -a[j]; break;
+    case NOT: for (int j = 0; j < count; j++) d[j] = a[j] == 0.0; break;
+    case ABS: for (int j = 0; j < count; j++) d[j] = std::fabs(a[j]); break;
+    case SQRT: for (int j = 0; j < count; j++) d[j] = std::sqrt(a[j]); break;
+    case EXP: for (int j = 0; j < count; j++) d[j] = std::exp(a[j]); break;
+    case LOG: for (int j = 0; j < count; j++) d[j] = std::log(a[j]); break;
+    case SIN: for (int j = 0; j < count; j++) d[j] = std::sin(a[j]); break;
+    case COS: for (int j = 0; j < count; j++) d[j] = std::cos(a[j]); break;
+    case TAN: for (int j = 0; j < count; j++) d[j] = std::tan(a[j]); break;
+    case FLOOR: for (int j = 0; j < count; j++) d[j] = std::floor(a[j]); break;
+    case CEIL: for (int j = 0; j < count; j++) d[j] = std::ceil(a[j]); break;
+    case SELECT: for (int j = 0; j < count; j++) d[j] = a[j] != 0.0 ? b[j] : c[j]; break;
+    }
+  }
+
+  std::copy(registers[result], registers[result] + count, out);
+}
@@ -0,0 +1,217 @@
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../include/muesli.h"
+#include "../include/jit.h"
+
+namespace {
+
+const char* KERNEL_FLAGS = "-O3 -march=native -std=c++17 -shared -fPIC";
+
+std::string compiler()
+{
+  const char* cxx = std::getenv("MUESLI_CXX");
+  return (cxx != nullptr && *cxx != '\0') ? cxx : "c++";
+}
+
+// Model and instruction set extensions of the host CPU as listed in
+// /proc/cpuinfo, which determine the code generated for -march=native.
+const std::string& hostCpu()
+{
+  static const char* FIELDS[] = {"vendor_id", "cpu family", "model", "model name", "stepping", "flags",
+                                 "CPU implementer", "CPU architecture", "CPU variant", "CPU part", "Features"};
+  static std::string cpu;
+  if (cpu.empty()) {
+    std::ifstream in("/proc/cpuinfo");
+    std::string line;
+    // the first processor is representative for the node
+    while (std::getline(in, line) && !line.empty()) {
+      size_t colon = line.find(':');
+      if (colon == std::string::npos) {
+        continue;
+      }
+      std::string field = line.substr(0, colon);
+      field.erase(field.find_last_not_of(" \t") + 1);
+      for (const char* f : FIELDS) {
+        if (field == f) {
+          cpu += line + "\n";
+        }
+      }
+    }
+    if (cpu.empty()) {
+      cpu = "unknown\n";
+    }
+  }
+  return cpu;
+}
+
+// 64 bit FNV-1a hash
+std::uint64_t hash(const std::string& s)
+{
+  std::uint64_t h = 14695981039346656037ULL;
+  for (unsigned char c : s) {
+    h ^= c;
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+std::string kernelSource(const std::string& body, const std::string& typeName, const std::string& typeDefinition)
+{
+  std::ostringstream s;
+  s << "#include <cmath>\n"
+    << "#include <cstdint>\n"
+    << typeDefinition
+    << "typedef " << typeName << " T;\n"
+    << "static inline T muesli_user_function(long i, long row, long col, T x, const double* p)\n"
+    << "{\n"
+    << body << "\n"
+    << "}\n"
+    << "extern \"C\" void muesli_kernel(const void* in_, void* out_, long count, long first, long ncol, const double* p)\n"
+    << "{\n"
+    << "  const T* in = static_cast<const T*>(in_);\n"
+    << "  T* out = static_cast<T*>(out_);\n"
+    // one inner loop per (part of a) row, so that it can be vectorized
+    << "  for (long k = 0; k < count;) {\n"
+    << "    long i = first + k;\n"
+    << "    long row = ncol > 0 ? i / ncol : 0;\n"
+    << "    long col = ncol > 0 ? i % ncol : i;\n"
+    << "    long len = ncol > 0 && ncol - col < count - k ? ncol - col : count - k;\n"
+    << "    for (long j = 0; j < len; j++) {\n"
+    << "      out[k + j] = muesli_user_function(i + j, row, col + j, in[k + j], p);\n"
+    << "    }\n"
+    << "    k += len;\n"
+    << "  }\n"
+    << "}\n";
+  return s.str();
+}
+
+bool fileExists(const std::string& path)
+{
+  struct stat st;
+  return stat(path.c_str(), &st) == 0;
+}
+
+void makeDirectories(const std::string& path)
+{
+  for (size_t pos = path.find('/', 1); ; pos = path.find('/', pos + 1)) {
+    mkdir(path.substr(0, pos).c_str(), 0755);
+    if (pos == std::string::npos) {
+      break;
+    }
+  }
+}
+
+// Compiles src into lib. Output is written to temporary files first and then
+// renamed, so that processes sharing the cache never see partial files.
+bool compile(const std::string& src, const std::string& lib)
+{
+  std::string base = lib.substr(0, lib.size() - 3);
+  std::string unique = "." + std::to_string(getpid()) + "." + std::to_string(msl::Muesli::proc_id);
+  std::string srcFile = base + unique + ".cpp";
+  std::string libFile = base + unique + ".so";
+  std::string logFile = base + unique + ".log";
+
+  std::ofstream(srcFile) << src;
+  std::string command = compiler() + " " + KERNEL_FLAGS + " -o '" + libFile + "' '" + srcFile + "' > '" + logFile + "' 2>&1";
+  if (std::system(command.c_str()) != 0 || !fileExists(libFile)) {
+    std::ifstream log(logFile);
+    std::string message((std::istreambuf_iterator<char>(log)), std::istreambuf_iterator<char>());
+    msl::throws(msl::detail::KernelCompilationException(command + "\n" + message));
+    std::remove(srcFile.c_str());
+    std::remove(libFile.c_str());
+    std::remove(logFile.c_str());
+    return false;
+  }
+  std::rename(srcFile.c_str(), (base + ".cpp").c_str());
+  std::rename(libFile.c_str(), lib.c_str());
+  std::remove(logFile.c_str());
+  return true;
+}
+
+// processes sharing a node (and thus usually the cache directory)
+MPI_Comm nodeCommunicator()
+{
+  static MPI_Comm node = MPI_COMM_NULL;
+  if (node == MPI_COMM_NULL) {
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, msl::Muesli::proc_id, MPI_INFO_NULL, &node);
+  }
+  return node;
+}
+
+// kernels already loaded by this process
+std::map<std::string, void*>& loadedKernels()
+{
+  static std::map<std::string, void*> kernels;
+  return kernels;
+}
+
+}
+
+std::string msl::getKernelCacheDirectory()
+{
+  const char* dir = std::getenv("MUESLI_KERNEL_CACHE");
+  if (dir != nullptr && *dir != '\0') {
+    return dir;
+  }
+  const char* cache = std::getenv("XDG_CACHE_HOME");
+  if (cache != nullptr && *cache != '\0') {
+    return std::string(cache) + "/muesli/kernels";
+  }
+  const char* home = std::getenv("HOME");
+  if (home != nullptr && *home != '\0') {
+    return std::string(home) + "/.cache/muesli/kernels";
+  }
+  return "/tmp/muesli-kernels";
+}
+
+msl::Kernel::Kernel(const std::string& body, const std::string& typeName, const std::string& typeDefinition)
+  : function(nullptr)
+{
+  std::string src = kernelSource(body, typeName, typeDefinition);
+  char key[17];
+  std::snprintf(key, sizeof(key), "%016" PRIx64, hash(compiler() + " " + KERNEL_FLAGS + "\n" + hostCpu() + src));
+
+  auto it = loadedKernels().find(key);
+  if (it != loadedKernels().end()) {
+    function = reinterpret_cast<Function>(it->second);
+    return;
+  }
+
+  std::string dir = getKernelCacheDirectory();
+  std::string lib = dir + "/k" + key + ".so";
+  makeDirectories(dir);
+
+  // the first process on each node compiles a missing kernel
+  MPI_Comm node = nodeCommunicator();
+  int nodeRank;
+  MPI_Comm_rank(node, &nodeRank);
+  int ok = 1;
+  if (nodeRank == 0 && !fileExists(lib)) {
+    ok = compile(src, lib);
+  }
+  MPI_Bcast(&ok, 1, MPI_INT, 0, node);
+  if (!ok || (!fileExists(lib) && !compile(src, lib))) {
+    return;
+  }
+
+  void* handle = dlopen(lib.c_str(), RTLD_NOW | RTLD_LOCAL);
+  void* symbol = handle != nullptr ? dlsym(handle, "muesli_kernel") : nullptr;
+  if (symbol == nullptr) {
+    const char* error = dlerror();
+    throws(detail::KernelCompilationException(error != nullptr ? error : lib));
+    return;
+  }
+  loadedKernels()[key] = symbol;
+  function = reinterpret_cast<Function>(symbol);
+}
+
+bool msl::Kernel::isValid() const
+{
+  return function != nullptr;
+}
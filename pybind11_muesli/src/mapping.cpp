@@ -0,0 +1,146 @@
+#include <cerrno>
+#include <mutex>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../include/detail/mapping.h"
+
+namespace {
+
+// a mapping as created by mmap; the region handed out starts inside it if the
+// requested offset is not page aligned
+struct Mapping
+{
+  void* base;
+  size_t length;
+  msl::detail::Access access;
+};
+
+// mappings by the start of the region handed out
+struct Mappings
+{
+  std::mutex mutex;
+  std::unordered_map<const void*, Mapping> regions;
+};
+
+Mappings& mappings()
+{
+  static Mappings instance;
+  return instance;
+}
+
+int adviceOf(msl::detail::Access access)
+{
+  return access == msl::detail::Access::SEQUENTIAL ? MADV_SEQUENTIAL : MADV_RANDOM;
+}
+
+bool find(const void* region, Mapping& mapping)
+{
+  Mappings& m = mappings();
+  std::lock_guard<std::mutex> lock(m.mutex);
+  auto it = m.regions.find(region);
+  if (it == m.regions.end()) {
+    return false;
+  }
+  mapping = it->second;
+  return true;
+}
+
+// extends the open file fd to at least bytes bytes
+bool reserve(int fd, size_t bytes)
+{
+  struct stat status;
+  if (fstat(fd, &status) != 0) {
+    return false;
+  }
+  if ((size_t) status.st_size >= bytes) {
+    return true;
+  }
+  return ftruncate(fd, (off_t) bytes) == 0;
+}
+
+}
+
+bool msl::detail::reserveFile(const std::string& path, size_t bytes)
+{
+  int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  bool done = reserve(fd, bytes);
+  int error = errno;
+  close(fd);
+  errno = error;
+  return done;
+}
+
+void* msl::detail::mapFile(const std::string& path, size_t offset, size_t bytes)
+{
+  if (bytes == 0) {
+    errno = EINVAL;
+    return nullptr;
+  }
+  int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    return nullptr;
+  }
+  // mmap requires a page aligned file offset
+  size_t page = (size_t) sysconf(_SC_PAGESIZE);
+  size_t skip = offset % page;
+  void* base = MAP_FAILED;
+  if (reserve(fd, offset + bytes)) {
+    base = mmap(nullptr, skip + bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, (off_t) (offset - skip));
+  }
+  // the mapping stays valid after the file is closed
+  int error = errno;
+  close(fd);
+  if (base == MAP_FAILED) {
+    errno = error;
+    return nullptr;
+  }
+  // skeletons mostly traverse the whole partition
+  madvise(base, skip + bytes, adviceOf(Access::SEQUENTIAL));
+  void* region = static_cast<char*>(base) + skip;
+  Mappings& m = mappings();
+  std::lock_guard<std::mutex> lock(m.mutex);
+  m.regions[region] = Mapping{base, skip + bytes, Access::SEQUENTIAL};
+  return region;
+}
+
+void msl::detail::unmapFile(void* region)
+{
+  Mapping mapping;
+  {
+    Mappings& m = mappings();
+    std::lock_guard<std::mutex> lock(m.mutex);
+    auto it = m.regions.find(region);
+    if (it == m.regions.end()) {
+      return;
+    }
+    mapping = it->second;
+    m.regions.erase(it);
+  }
+  munmap(mapping.base, mapping.length);
+}
+
+void msl::detail::advise(const void* region, Access access)
+{
+  Mappings& m = mappings();
+  std::lock_guard<std::mutex> lock(m.mutex);
+  auto it = m.regions.find(region);
+  // the hint is only passed on if the access pattern changes
+  if (it != m.regions.end() && it->second.access != access) {
+    madvise(it->second.base, it->second.length, adviceOf(access));
+    it->second.access = access;
+  }
+}
+
+void msl::detail::flushMapping(const void* region)
+{
+  Mapping mapping;
+  if (find(region, mapping)) {
+    msync(mapping.base, mapping.length, MS_SYNC);
+  }
+}
@@ -1,5 +1,11 @@
 #include <pybind11/pybind11.h>
+#include <algorithm>
+#include <thread>
 #include "../include/muesli.h"
+#include "../include/threadpool.h"
+#include "../include/detail/pool.h"
+#include "../include/detail/rma.h"
+#include "../include/detail/topology.h"
 
 int msl::Muesli::proc_id;
 int msl::Muesli::proc_entrance;
@@ -12,17 +18,22 @@ int msl::Muesli::distribution_mode;
 int msl::Muesli::task_group_size;
 int msl::Muesli::num_runs;
 int msl::Muesli::num_gpus;
+int msl::Muesli::batch_size = msl::DEFAULT_BATCH_SIZE;
+bool msl::Muesli::lazy_evaluation = false;
+int msl::Muesli::num_threads = 1;
+msl::HugePages msl::Muesli::huge_pages = msl::HugePages::NONE;
 bool msl::Muesli::debug_communication;
 bool msl::Muesli::use_timer;
 bool msl::Muesli::farm_statistics = false;
 msl::Timer* timer;
 
 
-void msl::initSkeletons(bool debug_communication)
+void msl::initSkeletons(bool debug_communication, int num_threads, Pinning pinning, HugePages huge_pages)
 {
   MPI_Init(NULL, NULL);
   MPI_Comm_size(MPI_COMM_WORLD, &Muesli::num_total_procs);
   MPI_Comm_rank(MPI_COMM_WORLD, &Muesli::proc_id);
+  detail::openPartitionWindow();
 
   int device_count = 0;
 
@@ -33,6 +44,38 @@ void msl::initSkeletons(bool debug_communication)
   Muesli::num_local_procs = Muesli::num_total_procs;
   Muesli::proc_entrance = 0;
   Muesli::start_time = MPI_Wtime();
+
+  // processes running on the same node
+  MPI_Comm node;
+  int procs_per_node, node_rank;
+  MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, Muesli::proc_id, MPI_INFO_NULL, &node);
+  MPI_Comm_size(node, &procs_per_node);
+  MPI_Comm_rank(node, &node_rank);
+  MPI_Comm_free(&node);
+
+  std::vector<int> cpus;
+  if (pinning == Pinning::RANKS) {
+    // each process gets a contiguous share of the cores, ordered by NUMA node
+    std::vector<int> all = detail::nodeCpus();
+    size_t begin = all.size() * node_rank / procs_per_node;
+    size_t end = all.size() * (node_rank + 1) / procs_per_node;
+    if (begin == end) {
+      // more processes than cores
+      end = begin + 1;
+    }
+    cpus.assign(all.begin() + begin, all.begin() + std::min(end, all.size()));
+  } else if (pinning == Pinning::THREADS) {
+    cpus = detail::allowedCpus();
+  }
+  pinThreads(cpus);
+
+  if (num_threads <= 0) {
+    // share the cores of a node among its processes
+    num_threads = pinning == Pinning::RANKS ? (int) cpus.size()
+                                            : (int) std::thread::hardware_concurrency() / procs_per_node;
+  }
+  setNumThreads(num_threads);
+  setHugePages(huge_pages);
 }
 
 void msl::terminateSkeletons()
@@ -54,7 +97,7 @@ void msl::terminateSkeletons()
 //    s << std::endl << "Name: " << Muesli::program_name << std::endl;
     s << "Proc: " << Muesli::num_total_procs << std::endl;
     s << "CPU only" << std::endl;
-//    s << "Threads per proc: " << Muesli::num_threads << std::endl;
+    s << "Threads per proc: " << Muesli::num_threads << std::endl;
     if (Muesli::use_timer) {
       s << s_time.str();
       delete timer;
@@ -67,6 +110,9 @@ void msl::terminateSkeletons()
   /*if (isRootProcess())
     printf("debug: behind output of run time statistics\n");*/
 
+  releaseThreadPool();
+  detail::clearPool();
+  detail::closePartitionWindow();
   MPI_Finalize();
   Muesli::running_proc_no = 0;
 }
@@ -91,6 +137,51 @@ void msl::setTaskGroupSize(int size)
   Muesli::task_group_size = size;
 }
 
+void msl::setBatchSize(int size)
+{
+  Muesli::batch_size = size;
+}
+
+int msl::getBatchSize()
+{
+  return Muesli::batch_size;
+}
+
+void msl::setNumThreads(int num_threads)
+{
+  Muesli::num_threads = num_threads > 0 ? num_threads : 1;
+}
+
+int msl::getNumThreads()
+{
+  return Muesli::num_threads;
+}
+
+void msl::setHugePages(HugePages pages)
+{
+  Muesli::huge_pages = pages;
+}
+
+msl::HugePages msl::getHugePages()
+{
+  return Muesli::huge_pages;
+}
+
+void msl::setLazyEvaluation(bool val)
+{
+  Muesli::lazy_evaluation = val;
+}
+
+bool msl::getLazyEvaluation()
+{
+  return Muesli::lazy_evaluation;
+}
+
+void msl::clearPartitionPool()
+{
+  detail::clearPool();
+}
+
 void msl::startTiming()
 {
   Muesli::use_timer = 1;
@@ -137,15 +228,36 @@ void msl::throws(const detail::Exception& e)
 }
 
 void bind_muesli(py::module& m) {
-  m.def("initSkeletons", &msl::initSkeletons);
+  py::enum_<msl::Pinning>(m, "Pinning")
+      .value("NONE", msl::Pinning::NONE)
+      .value("THREADS", msl::Pinning::THREADS)
+      .value("RANKS", msl::Pinning::RANKS)
+  ;
+  py::enum_<msl::HugePages>(m, "HugePages")
+      .value("NONE", msl::HugePages::NONE)
+      .value("TRANSPARENT", msl::HugePages::TRANSPARENT)
+      .value("EXPLICIT", msl::HugePages::EXPLICIT)
+  ;
+  m.def("initSkeletons", &msl::initSkeletons, py::arg("debug_communication") = false, py::arg("num_threads") = 0,
+        py::arg("pinning") = msl::Pinning::NONE, py::arg("huge_pages") = msl::HugePages::NONE);
   m.def("terminateSkeletons", &msl::terminateSkeletons);
   m.def("setNumRuns", &msl::setNumRuns);
   m.def("getNumRuns", &msl::getNumRuns);
   m.def("getNumGpus", &msl::getNumGpus);
   m.def("setTaskGroupSize", &msl::setTaskGroupSize);
+  m.def("setBatchSize", &msl::setBatchSize);
+  m.def("getBatchSize", &msl::getBatchSize);
+  m.def("setNumThreads", &msl::setNumThreads);
+  m.def("getNumThreads", &msl::getNumThreads);
+  m.def("setHugePages", &msl::setHugePages);
+  m.def("getHugePages", &msl::getHugePages);
+  m.def("setLazyEvaluation", &msl::setLazyEvaluation);
+  m.def("getLazyEvaluation", &msl::getLazyEvaluation);
+  m.def("clearPartitionPool", &msl::clearPartitionPool);
   m.def("setFarmStatistics", &msl::setFarmStatistics);
   m.def("fail_exit", &msl::fail_exit);
   m.def("isRootProcess", &msl::isRootProcess);
+  m.def("barrier", &msl::barrier, py::call_guard<py::gil_scoped_release>());
   py::class_<msl::Muesli>(m, "Muesli")
       .def_readonly_static("num_runs",  &msl::Muesli::num_runs)
   ;
@@ -65,16 +65,16 @@ inline void msl::MSL_ReceiveTag(int source, int tag)
 template <typename T>
 inline void msl::MSL_Send(int destination, T* send_buffer, size_t size, int tag)
 {
-  size_t s = size * sizeof(T);
-  MPI_Send(send_buffer, s, MPI_BYTE, destination, tag, MPI_COMM_WORLD);
+  detail::Message m(size * sizeof(T));
+  MPI_Send(send_buffer, m.count, m.type, destination, tag, MPI_COMM_WORLD);
 }
 
 // Sends (non-blocking) a buffer of type T to process destination.
 template <typename T>
 inline void msl::MSL_ISend(int destination, T* send_buffer, MPI_Request& req, size_t size, int tag)
 {
-  size_t s = size * sizeof(T);
-  MPI_Isend(send_buffer, s, MPI_BYTE, destination, tag, MPI_COMM_WORLD, &req);
+  detail::Message m(size * sizeof(T));
+  MPI_Isend(send_buffer, m.count, m.type, destination, tag, MPI_COMM_WORLD, &req);
 }
 
 // Receives a buffer of type T from process source.
@@ -82,24 +82,24 @@ template <typename T>
 inline void msl::MSL_Recv(int source, T* recv_buffer, size_t size, int tag)
 {
   MPI_Status status;
-  size_t s = size * sizeof(T);
-  MPI_Recv(recv_buffer, s, MPI_BYTE, source, tag, MPI_COMM_WORLD, &status);
+  detail::Message m(size * sizeof(T));
+  MPI_Recv(recv_buffer, m.count, m.type, source, tag, MPI_COMM_WORLD, &status);
 }
 
 // Receives a buffer of type T from process source.
 template <typename T>
 inline void msl::MSL_Recv(int source, T* recv_buffer, MPI_Status& stat, size_t size, int tag)
 {
-  size_t s = size * sizeof(T);
-  MPI_Recv(recv_buffer, s, MPI_BYTE, source, tag, MPI_COMM_WORLD, &stat);
+  detail::Message m(size * sizeof(T));
+  MPI_Recv(recv_buffer, m.count, m.type, source, tag, MPI_COMM_WORLD, &stat);
 }
 
 // Receives a buffer of type T from process source. Asynchronous receive.
 template <typename T>
 inline void msl::MSL_IRecv(int source, T* recv_buffer, MPI_Request& req, size_t size, int tag)
 {
-  size_t s = size * sizeof(T);
-  MPI_Irecv(recv_buffer, s, MPI_BYTE, source, tag, MPI_COMM_WORLD, &req);
+  detail::Message m(size * sizeof(T));
+  MPI_Irecv(recv_buffer, m.count, m.type, source, tag, MPI_COMM_WORLD, &req);
 }
 
 // Send/receive function for sending a buffer of type T to process destination and
@@ -262,25 +262,128 @@ void msl::allgather(T* send_buffer, T* recv_buffer, int* const ids, int np, size
 }
 
 template<typename T>
-//void msl::allgather(T* send_buffer, T* recv_buffer, size_t count)
-void msl::allgather(T* send_buffer, T* recv_buffer, int count)
+void msl::allgather(T* send_buffer, T* recv_buffer, size_t count)
 {
-  size_t bytes = count * sizeof(T);
-  MPI_Allgather(send_buffer, bytes, MPI_BYTE, recv_buffer, bytes, MPI_BYTE, MPI_COMM_WORLD);
+  detail::Message m(count * sizeof(T));
+  MPI_Allgather(send_buffer, m.count, m.type, recv_buffer, m.count, m.type, MPI_COMM_WORLD);
+}
+
+template<typename T>
+void msl::gatherv(const T* send_buffer, T* recv_buffer, const long* bounds, int root)
+{
+  int np = Muesli::num_total_procs;
+  int id = Muesli::proc_id;
+  long count = bounds[id + 1] - bounds[id];
+  std::vector<int> counts, displs;
+  if (detail::vectorCounts(bounds, np, counts, displs)) {
+    // counts and displacements are given in units of one element
+    MPI_Datatype element;
+    MPI_Type_contiguous((int) sizeof(T), MPI_BYTE, &element);
+    MPI_Type_commit(&element);
+    MPI_Gatherv(send_buffer, (int) count, element, recv_buffer, counts.data(), displs.data(), element,
+                root, MPI_COMM_WORLD);
+    MPI_Type_free(&element);
+    return;
+  }
+  // displacements exceed an int
+  if (id != root) {
+    detail::Message m(count * sizeof(T));
+    MPI_Send(send_buffer, m.count, m.type, root, MYTAG, MPI_COMM_WORLD);
+    return;
+  }
+  std::copy(send_buffer, send_buffer + count, recv_buffer + bounds[id]);
+  for (int p = 0; p < np; p++) {
+    if (p != root) {
+      detail::Message m((bounds[p + 1] - bounds[p]) * sizeof(T));
+      MPI_Recv(recv_buffer + bounds[p], m.count, m.type, p, MYTAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    }
+  }
+}
+
+template<typename T>
+void msl::allgatherv(const T* send_buffer, T* recv_buffer, const long* bounds)
+{
+  int np = Muesli::num_total_procs;
+  int id = Muesli::proc_id;
+  std::vector<int> counts, displs;
+  if (detail::vectorCounts(bounds, np, counts, displs)) {
+    MPI_Datatype element;
+    MPI_Type_contiguous((int) sizeof(T), MPI_BYTE, &element);
+    MPI_Type_commit(&element);
+    MPI_Allgatherv(send_buffer, counts[id], element, recv_buffer, counts.data(), displs.data(), element,
+                   MPI_COMM_WORLD);
+    MPI_Type_free(&element);
+    return;
+  }
+  gatherv(send_buffer, recv_buffer, bounds, 0);
+  MSL_Broadcast(0, recv_buffer, bounds[np]);
 }
 
 template<typename T>
 void msl::scatter(T* send_buffer, T* recv_buffer, size_t count)
 {
-  size_t bytes = count * sizeof(T);
-  MPI_Scatter(send_buffer, bytes, MPI_BYTE, recv_buffer, bytes, MPI_BYTE, 0, MPI_COMM_WORLD);
+  detail::Message m(count * sizeof(T));
+  MPI_Scatter(send_buffer, m.count, m.type, recv_buffer, m.count, m.type, 0, MPI_COMM_WORLD);
+}
+
+template<typename T>
+void msl::scatterv(const T* send_buffer, T* recv_buffer, const long* bounds, int root)
+{
+  int np = Muesli::num_total_procs;
+  int id = Muesli::proc_id;
+  long count = bounds[id + 1] - bounds[id];
+  std::vector<int> counts, displs;
+  if (detail::vectorCounts(bounds, np, counts, displs)) {
+    // counts and displacements are given in units of one element
+    MPI_Datatype element;
+    MPI_Type_contiguous((int) sizeof(T), MPI_BYTE, &element);
+    MPI_Type_commit(&element);
+    MPI_Scatterv(send_buffer, counts.data(), displs.data(), element, recv_buffer, (int) count, element,
+                 root, MPI_COMM_WORLD);
+    MPI_Type_free(&element);
+    return;
+  }
+  // displacements exceed an int
+  if (id != root) {
+    detail::Message m(count * sizeof(T));
+    MPI_Recv(recv_buffer, m.count, m.type, root, MYTAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    return;
+  }
+  for (int p = 0; p < np; p++) {
+    if (p != root) {
+      detail::Message m((bounds[p + 1] - bounds[p]) * sizeof(T));
+      MPI_Send(send_buffer + bounds[p], m.count, m.type, p, MYTAG, MPI_COMM_WORLD);
+    }
+  }
+  std::copy(send_buffer + bounds[id], send_buffer + bounds[id + 1], recv_buffer);
+}
+
+template<typename T>
+void msl::alltoall(T* send_buffer, T* recv_buffer, int count)
+{
+  detail::Message m(count * sizeof(T));
+  MPI_Alltoall(send_buffer, m.count, m.type, recv_buffer, m.count, m.type, MPI_COMM_WORLD);
+}
+
+template<typename T>
+void msl::alltoallv(const T* send_buffer, const int* send_counts, const int* send_displs,
+                    T* recv_buffer, const int* recv_counts, const int* recv_displs)
+{
+  // counts and displacements are given in units of one element
+  MPI_Datatype element;
+  MPI_Type_contiguous((int) sizeof(T), MPI_BYTE, &element);
+  MPI_Type_commit(&element);
+  MPI_Alltoallv(send_buffer, send_counts, send_displs, element,
+                recv_buffer, recv_counts, recv_displs, element, MPI_COMM_WORLD);
+  MPI_Type_free(&element);
 }
 
 // Broadcast.
 template <typename T>
-inline void msl::MSL_Broadcast(int source, T* buffer, int size)
+inline void msl::MSL_Broadcast(int source, T* buffer, size_t size)
 {
-  MPI_Bcast(buffer, size * sizeof(T), MPI_BYTE, source, MPI_COMM_WORLD);
+  detail::Message m(size * sizeof(T));
+  MPI_Bcast(buffer, m.count, m.type, source, MPI_COMM_WORLD);
 }
 
 // Barrier.
@@ -299,8 +402,8 @@ inline void msl::barrier()
 template <typename T>
 inline void msl::MSL_Send(int destination, std::vector<T>& send_buffer, int tag)
 {
-  size_t bytes = send_buffer.size() * sizeof(T);
-  MPI_Send(send_buffer.data(), bytes, MPI_BYTE, destination, tag, MPI_COMM_WORLD);
+  detail::Message m(send_buffer.size() * sizeof(T));
+  MPI_Send(send_buffer.data(), m.count, m.type, destination, tag, MPI_COMM_WORLD);
 }
 
 // Receives a vector of type T from process source.
@@ -308,15 +411,15 @@ template <typename T>
 inline void msl::MSL_Recv(int source, std::vector<T>& recv_buffer, int tag)
 {
   MPI_Status status;
-  int bytes;
+  MPI_Count bytes;
 
   MPI_Probe(source, tag, MPI_COMM_WORLD, &status);
-  MPI_Get_count(&status, MPI_BYTE, &bytes);
+  MPI_Get_elements_x(&status, MPI_BYTE, &bytes);
 
-  int count = bytes / sizeof(T);
-  recv_buffer.resize(count);
+  recv_buffer.resize(bytes / sizeof(T));
 
-  MPI_Recv(recv_buffer.data(), bytes, MPI_BYTE, source, tag, MPI_COMM_WORLD, &status);
+  detail::Message m(bytes);
+  MPI_Recv(recv_buffer.data(), m.count, m.type, source, tag, MPI_COMM_WORLD, &status);
 }
 
 
@@ -0,0 +1,57 @@
+#include <pybind11/pybind11.h>
+#include "../include/muesli.h"
+#include "../include/operators.h"
+
+bool msl::parseOperator(const std::string& name, Operator& op)
+{
+  static const struct { const char* name; const char* symbol; Operator op; } operators[] = {
+    {"identity", "",   Operator::IDENTITY},
+    {"add",      "+",  Operator::ADD},
+    {"sub",      "-",  Operator::SUB},
+    {"mul",      "*",  Operator::MUL},
+    {"div",      "/",  Operator::DIV},
+    {"affine",   "",   Operator::AFFINE},
+    {"clamp",    "",   Operator::CLAMP},
+    {"abs",      "",   Operator::ABS},
+    {"neg",      "",   Operator::NEG},
+    {"min",      "",   Operator::MIN},
+    {"max",      "",   Operator::MAX},
+    {"eq",       "==", Operator::EQ},
+    {"ne",       "!=", Operator::NE},
+    {"lt",       "<",  Operator::LT},
+    {"le",       "<=", Operator::LE},
+    {"gt",       ">",  Operator::GT},
+    {"ge",       ">=", Operator::GE},
+  };
+
+  for (const auto& o : operators) {
+    if (name == o.name || (o.symbol[0] != '\0' && name == o.symbol)) {
+      op = o.op;
+      return true;
+    }
+  }
+  throws(detail::UnknownOperatorException(name));
+  return false;
+}
+
+void bind_operators(py::module& m) {
+  py::enum_<msl::Operator>(m, "Operator")
+      .value("IDENTITY", msl::Operator::IDENTITY)
+      .value("ADD", msl::Operator::ADD)
+      .value("SUB", msl::Operator::SUB)
+      .value("MUL", msl::Operator::MUL)
+      .value("DIV", msl::Operator::DIV)
+      .value("AFFINE", msl::Operator::AFFINE)
+      .value("CLAMP", msl::Operator::CLAMP)
+      .value("ABS", msl::Operator::ABS)
+      .value("NEG", msl::Operator::NEG)
+      .value("MIN", msl::Operator::MIN)
+      .value("MAX", msl::Operator::MAX)
+      .value("EQ", msl::Operator::EQ)
+      .value("NE", msl::Operator::NE)
+      .value("LT", msl::Operator::LT)
+      .value("LE", msl::Operator::LE)
+      .value("GT", msl::Operator::GT)
+      .value("GE", msl::Operator::GE)
+  ;
+}
@@ -0,0 +1,160 @@
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <vector>
+#include <sys/mman.h>
+#include "../include/detail/pool.h"
+
+using msl::HugePages;
+
+namespace {
+
+const int KINDS = 3;
+
+// Released blocks kept per size class and kind of pages. Iterative
+// applications alternate between a few containers of the same size, so more
+// blocks would only hold on to memory no one is going to reuse.
+const size_t BLOCKS_PER_CLASS = 4;
+
+// released blocks by kind of pages and size class
+struct Pool
+{
+  std::mutex mutex;
+  std::unordered_map<size_t, std::vector<void*>> blocks[KINDS];
+  size_t bytes = 0;
+};
+
+Pool& pool()
+{
+  static Pool instance;
+  return instance;
+}
+
+// Rounds a request up to its size class: a multiple of the alignment below
+// 1 KiB, a quarter of the enclosing power of two above. Reuse thus wastes at
+// most a quarter of a block. Blocks of huge pages consist of whole pages.
+size_t sizeClass(size_t bytes, HugePages pages)
+{
+  const size_t alignment = msl::detail::PARTITION_ALIGNMENT;
+  if (bytes <= 1024) {
+    return (bytes + alignment - 1) / alignment * alignment;
+  }
+  size_t power = 1024;
+  while (power < bytes / 2) {
+    power *= 2;
+  }
+  size_t step = power / 4;
+  if (pages != HugePages::NONE && step < msl::detail::HUGE_PAGE) {
+    step = msl::detail::HUGE_PAGE;
+  }
+  return (bytes + step - 1) / step * step;
+}
+
+void* allocate(size_t size, HugePages& pages)
+{
+  const size_t HUGE_PAGE = msl::detail::HUGE_PAGE;
+  if (pages == HugePages::EXPLICIT) {
+    void* block = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (block != MAP_FAILED) {
+      return block;
+    }
+    // no huge pages reserved
+    pages = HugePages::TRANSPARENT;
+  }
+  if (pages == HugePages::TRANSPARENT) {
+    void* block = std::aligned_alloc(HUGE_PAGE, size);
+    // without transparent huge pages the block simply keeps small pages
+    if (block != nullptr) {
+      madvise(block, size, MADV_HUGEPAGE);
+    }
+    return block;
+  }
+  return std::aligned_alloc(msl::detail::PARTITION_ALIGNMENT, size);
+}
+
+void release(void* block, size_t size, HugePages pages)
+{
+  if (pages == HugePages::EXPLICIT) {
+    munmap(block, size);
+  } else {
+    std::free(block);
+  }
+}
+
+}
+
+void* msl::detail::allocateBlock(size_t bytes, HugePages& pages)
+{
+  if (bytes < HUGE_PAGE) {
+    pages = HugePages::NONE;
+  }
+  {
+    Pool& p = pool();
+    std::lock_guard<std::mutex> lock(p.mutex);
+    // explicit huge pages fall back to transparent ones, so blocks of those
+    // are reused as well
+    int lowest = pages == HugePages::EXPLICIT ? (int) HugePages::TRANSPARENT : (int) pages;
+    for (int kind = (int) pages; kind >= lowest; kind--) {
+      size_t size = sizeClass(bytes, (HugePages) kind);
+      auto it = p.blocks[kind].find(size);
+      if (it != p.blocks[kind].end() && !it->second.empty()) {
+        void* block = it->second.back();
+        it->second.pop_back();
+        p.bytes -= size;
+        pages = (HugePages) kind;
+        return block;
+      }
+    }
+  }
+  HugePages requested = pages;
+  void* block = allocate(sizeClass(bytes, pages), pages);
+  if (block == nullptr) {
+    // the pooled blocks may be of the wrong size; give them back and retry
+    clearPool();
+    pages = requested;
+    block = allocate(sizeClass(bytes, pages), pages);
+    if (block == nullptr) {
+      throw std::bad_alloc();
+    }
+  }
+  return block;
+}
+
+void msl::detail::releaseBlock(void* block, size_t bytes, HugePages pages)
+{
+  size_t size = sizeClass(bytes, pages);
+  Pool& p = pool();
+  {
+    std::lock_guard<std::mutex> lock(p.mutex);
+    std::vector<void*>& blocks = p.blocks[(int) pages][size];
+    if (blocks.size() < BLOCKS_PER_CLASS) {
+      blocks.push_back(block);
+      p.bytes += size;
+      return;
+    }
+  }
+  release(block, size, pages);
+}
+
+void msl::detail::clearPool()
+{
+  Pool& p = pool();
+  std::lock_guard<std::mutex> lock(p.mutex);
+  for (int kind = 0; kind < KINDS; kind++) {
+    for (auto& entry : p.blocks[kind]) {
+      for (void* block : entry.second) {
+        release(block, entry.first, (HugePages) kind);
+      }
+    }
+    p.blocks[kind].clear();
+  }
+  p.bytes = 0;
+}
+
+size_t msl::detail::pooledBytes()
+{
+  Pool& p = pool();
+  std::lock_guard<std::mutex> lock(p.mutex);
+  return p.bytes;
+}
@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "../include/muesli.h"
+#include "../include/detail/exception.h"
+#include "../include/detail/rma.h"
+
+namespace {
+
+using msl::detail::PartitionHeader;
+
+// number of containers per process that can be accessed remotely at a time
+const int HEADERS = 1 << 14;
+
+// window of the local partitions with the number of users of each attached
+// region, and the table of headers of the containers
+struct PartitionWindow
+{
+  std::mutex mutex;
+  MPI_Win window = MPI_WIN_NULL;
+  std::unordered_map<void*, int> regions;
+  // the table never moves, so its address is exchanged only once
+  std::vector<PartitionHeader> headers = std::vector<PartitionHeader>(HEADERS);
+  std::vector<MPI_Aint> tables;
+  // free slots, the lowest one on top
+  std::vector<int> free;
+  long nextId = 0;
+
+  PartitionWindow()
+  {
+    for (int slot = HEADERS - 1; slot >= 0; slot--) {
+      free.push_back(slot);
+    }
+  }
+};
+
+PartitionWindow& partitions()
+{
+  static PartitionWindow instance;
+  return instance;
+}
+
+}
+
+void msl::detail::openPartitionWindow()
+{
+  PartitionWindow& w = partitions();
+  std::lock_guard<std::mutex> lock(w.mutex);
+  if (w.window != MPI_WIN_NULL) {
+    return;
+  }
+  // some MPI implementations offer no dynamic windows (e.g. for a single
+  // process); remote accesses then only reach the local partition
+  MPI_Errhandler handler;
+  MPI_Comm_get_errhandler(MPI_COMM_WORLD, &handler);
+  MPI_Comm_set_errhandler(MPI_COMM_WORLD, MPI_ERRORS_RETURN);
+  int result = MPI_Win_create_dynamic(MPI_INFO_NULL, MPI_COMM_WORLD, &w.window);
+  MPI_Comm_set_errhandler(MPI_COMM_WORLD, handler);
+  MPI_Errhandler_free(&handler);
+  if (result != MPI_SUCCESS) {
+    w.window = MPI_WIN_NULL;
+    int np;
+    MPI_Comm_size(MPI_COMM_WORLD, &np);
+    if (np > 1) {
+      msl::throws(msl::detail::FeatureNotSupportedByDeviceException("One-sided access to partitions"));
+    }
+    return;
+  }
+  // a passive target epoch for the whole run; accesses are completed by flushes
+  MPI_Win_lock_all(MPI_MODE_NOCHECK, w.window);
+
+  // the header tables stay attached until the window is closed
+  int np;
+  MPI_Comm_size(MPI_COMM_WORLD, &np);
+  MPI_Win_attach(w.window, w.headers.data(), (MPI_Aint) (HEADERS * sizeof(PartitionHeader)));
+  MPI_Aint table;
+  MPI_Get_address(w.headers.data(), &table);
+  w.tables.resize(np);
+  MPI_Allgather(&table, 1, MPI_AINT, w.tables.data(), 1, MPI_AINT, MPI_COMM_WORLD);
+}
+
+void msl::detail::closePartitionWindow()
+{
+  PartitionWindow& w = partitions();
+  std::lock_guard<std::mutex> lock(w.mutex);
+  if (w.window == MPI_WIN_NULL) {
+    return;
+  }
+  // containers still alive detach nothing once the window is gone
+  for (auto& region : w.regions) {
+    MPI_Win_detach(w.window, region.first);
+  }
+  w.regions.clear();
+  MPI_Win_detach(w.window, w.headers.data());
+  w.tables.clear();
+  MPI_Win_unlock_all(w.window);
+  MPI_Win_free(&w.window);
+  w.window = MPI_WIN_NULL;
+}
+
+MPI_Win msl::detail::partitionWindow()
+{
+  PartitionWindow& w = partitions();
+  std::lock_guard<std::mutex> lock(w.mutex);
+  return w.window;
+}
+
+void msl::detail::attachRegion(void* base, size_t bytes)
+{
+  PartitionWindow& w = partitions();
+  std::lock_guard<std::mutex> lock(w.mutex);
+  if (w.window == MPI_WIN_NULL) {
+    return;
+  }
+  // attaching overlapping regions is erroneous, so a shared one is attached once
+  if (w.regions[base]++ == 0) {
+    MPI_Win_attach(w.window, base, (MPI_Aint) bytes);
+  }
+}
+
+void msl::detail::detachRegion(void* base)
+{
+  PartitionWindow& w = partitions();
+  std::lock_guard<std::mutex> lock(w.mutex);
+  auto it = w.regions.find(base);
+  if (w.window == MPI_WIN_NULL || it == w.regions.end()) {
+    return;
+  }
+  if (--it->second == 0) {
+    MPI_Win_detach(w.window, base);
+    w.regions.erase(it);
+  }
+}
+
+int msl::detail::claimHeader(long& id)
+{
+  PartitionWindow& w = partitions();
+  std::lock_guard<std::mutex> lock(w.mutex);
+  if (w.free.empty()) {
+    msl::throws(msl::detail::FeatureNotSupportedByDeviceException("One-sided access to this many containers"));
+    return -1;
+  }
+  int slot = w.free.back();
+  w.free.pop_back();
+  id = w.nextId++;
+  w.headers[slot] = PartitionHeader{0, id, 0};
+  return slot;
+}
+
+void msl::detail::releaseHeader(int slot)
+{
+  PartitionWindow& w = partitions();
+  std::lock_guard<std::mutex> lock(w.mutex);
+  // keep the order in which slots are handed out independent of the order in
+  // which they were released
+  w.headers[slot] = PartitionHeader{0, -1, 0};
+  w.free.insert(std::upper_bound(w.free.begin(), w.free.end(), slot, std::greater<int>()), slot);
+}
+
+msl::detail::PartitionHeader& msl::detail::localHeader(int slot)
+{
+  return partitions().headers[slot];
+}
+
+msl::detail::PartitionHeader msl::detail::remoteHeader(int rank, int slot)
+{
+  PartitionWindow& w = partitions();
+  PartitionHeader header{0, -1, 0};
+  MPI_Aint address = MPI_Aint_add(w.tables[rank], (MPI_Aint) (slot * sizeof(PartitionHeader)));
+  MPI_Get(&header, sizeof(PartitionHeader), MPI_BYTE, rank, address, sizeof(PartitionHeader), MPI_BYTE, w.window);
+  MPI_Win_flush(rank, w.window);
+  return header;
+}
@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <vector>
+#include "../include/muesli.h"
+#include "../include/soadm.h"
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+#include <pybind11/numpy.h>
+#include <pybind11/functional.h>
+
+namespace py = pybind11;
+
+template<typename T>
+msl::SoADM<T>::SoADM(int row, int col)
+    : ncol(col), nrow(row), n((long) col * row) {
+    init();
+}
+
+template<typename T>
+msl::SoADM<T>::SoADM(int row, int col, const T& v)
+    : ncol(col), nrow(row), n((long) col * row) {
+    init();
+    fill(v);
+}
+
+template<typename T>
+void msl::SoADM<T>::init() {
+    if (Muesli::proc_entrance == UNDEFINED) {
+        throws(detail::MissingInitializationException());
+    }
+    id = Muesli::proc_id;
+    np = Muesli::num_total_procs;
+    if ((n + np - 1) / np > INT_MAX) {
+        throws(detail::PartitioningImpossibleException());
+        // left empty rather than with truncated partitions
+        nrow = 0;
+        ncol = 0;
+        n = 0;
+    }
+    nLocal = detail::partitionSize(n, np, id);
+    firstIndex = detail::partitionStart(n, np, id);
+    // planes start at aligned addresses
+    const int align = detail::PARTITION_ALIGNMENT / sizeof(Field);
+    int stride = (nLocal + align - 1) / align * align;
+    buffer = detail::allocatePartition<Field>(stride * FIELDS, Muesli::huge_pages, FIELDS);
+    for (int f = 0; f < FIELDS; f++) {
+        planes[f] = buffer.get() + f * stride;
+    }
+}
+
+template<typename T>
+void msl::SoADM<T>::fill(const T& value) {
+    Field* const* p = planes.data();
+    parallelFor(nLocal, ThreadPool::GRAIN, [p, &value](int begin, int end) {
+        for (int k = begin; k < end; k++) {
+            SoATraits<T>::store(value, p, k);
+        }
+    });
+}
+
+//*********************************** Maps ***********************************
+template<typename T>
+void msl::SoADM<T>::mapBlocks(const typename detail::Pipeline<T>::Stage& stage, bool isNative) {
+    Field* const* p = planes.data();
+    long offset = firstIndex;
+    auto run = [p, offset, &stage](int begin, int end) {
+        std::vector<T> block(std::min(detail::Pipeline<T>::BLOCK, end - begin));
+        for (int k = begin; k < end; k += (int) block.size()) {
+            int count = std::min((int) block.size(), end - k);
+            for (int j = 0; j < count; j++) {
+                block[j] = SoATraits<T>::load(p, k + j);
+            }
+            stage(block.data(), count, offset + k);
+            for (int j = 0; j < count; j++) {
+                SoATraits<T>::store(block[j], p, k + j);
+            }
+        }
+    };
+    if (isNative) {
+        parallelFor(nLocal, detail::Pipeline<T>::FINE_BLOCK, run);
+    } else {
+        run(0, nLocal);
+    }
+}
+
+template<typename T>
+void msl::SoADM<T>::mapIndexInPlaceM(const std::function<T(int,int,T)> &f) {
+    int cols = ncol;
+    mapBlocks([&f, cols](T* block, int count, long first) {
+        for (int k = 0; k < count; k++) {
+            block[k] = f((first + k) / cols, (first + k) % cols, block[k]);
+        }
+    }, false);
+}
+
+template<typename T>
+void msl::SoADM<T>::mapInPlaceKernel(const std::string& body, const std::vector<double>& params) {
+    Kernel kernel = Kernel::create<T>(body);
+    if (!kernel.isValid()) {
+        return;
+    }
+    int cols = ncol;
+    mapBlocks([&kernel, &params, cols](T* block, int count, long first) {
+        kernel.run(block, block, count, first, cols, params);
+    }, true);
+}
+
+//******************************** Getters *********************************
+template<typename T>
+T msl::SoADM<T>::get(long index) const {
+    T message;
+    int idSource = detail::partitionOwner(n, np, index);
+    if (idSource == id) {
+        message = SoATraits<T>::load(planes.data(), index - firstIndex);
+    }
+    msl::MSL_Broadcast(idSource, &message, 1);
+    return message;
+}
+
+template<typename T>
+int msl::SoADM<T>::fieldIndex(const std::string& name) const {
+    for (int f = 0; f < FIELDS; f++) {
+        if (name == SoATraits<T>::name(f)) {
+            return f;
+        }
+    }
+    return -1;
+}
+
+template<typename T>
+py::array_t<typename msl::SoADM<T>::Field> msl::SoADM<T>::getPlane(int field) {
+    if (field < 0 || field >= FIELDS) {
+        throws(detail::UnknownFieldException(std::to_string(field)));
+        return py::array_t<Field>();
+    }
+    // the plane keeps this matrix alive
+    py::object owner = py::cast(this, py::return_value_policy::reference);
+    if (ncol > 0 && firstIndex % ncol == 0 && nLocal % ncol == 0) {
+        return py::array_t<Field>({nLocal / ncol, ncol}, planes[field], owner);
+    }
+    return py::array_t<Field>({nLocal}, planes[field], owner);
+}
+
+template<typename T>
+py::array_t<typename msl::SoADM<T>::Field> msl::SoADM<T>::getPlane(const std::string& field) {
+    int f = fieldIndex(field);
+    if (f < 0) {
+        throws(detail::UnknownFieldException(field));
+        return py::array_t<Field>();
+    }
+    return getPlane(f);
+}
+
+template<typename T>
+py::array_t<typename msl::SoADM<T>::Field> msl::SoADM<T>::gatherPlane(int field) const {
+    if (field < 0 || field >= FIELDS) {
+        throws(detail::UnknownFieldException(std::to_string(field)));
+        return py::array_t<Field>();
+    }
+    py::array_t<Field> result({nrow, ncol});
+    msl::allgatherv(planes[field], result.mutable_data(), detail::partitionBounds(n, np).data());
+    return result;
+}
+
+template<typename T>
+py::array_t<typename msl::SoADM<T>::Field> msl::SoADM<T>::gather() const {
+    std::vector<Field> all((size_t) n * FIELDS);
+    std::vector<long> bounds = detail::partitionBounds(n, np);
+    for (int f = 0; f < FIELDS; f++) {
+        msl::allgatherv(planes[f], all.data() + (size_t) f * n, bounds.data());
+    }
+    py::array_t<Field> result({nrow, ncol, FIELDS});
+    Field* out = result.mutable_data();
+    const Field* in = all.data();
+    size_t size = n;
+    size_t cols = ncol;
+    // rows are scheduled, since n may exceed the range of an int
+    parallelFor(nrow, 1, [out, in, size, cols](int begin, int end) {
+        for (size_t k = begin * cols; k < end * cols; k++) {
+            for (int f = 0; f < FIELDS; f++) {
+                out[k * FIELDS + f] = in[f * size + k];
+            }
+        }
+    });
+    return result;
+}
+
+template<typename T>
+int msl::SoADM<T>::getRows() const {
+    return nrow;
+}
+
+template<typename T>
+int msl::SoADM<T>::getCols() const {
+    return ncol;
+}
+
+template<typename T>
+long msl::SoADM<T>::getSize() const {
+    return n;
+}
+
+template<typename T>
+int msl::SoADM<T>::getLocalSize() const {
+    return nLocal;
+}
+
+template<typename T>
+long msl::SoADM<T>::getFirstIndex() const {
+    return firstIndex;
+}
+
+void bind_soadm(py::module& m) {
+    py::class_<msl::SoADM<Pixel>>(m, "MandelbrotSoA")
+        .def(py::init<int, int>())
+        .def(py::init<int, int, Pixel>())
+        .def("getRows", &msl::SoADM<Pixel>::getRows)
+        .def("getCols", &msl::SoADM<Pixel>::getCols)
+        .def("get", &msl::SoADM<Pixel>::get)
+        .def("fill", &msl::SoADM<Pixel>::fill)
+        .def("getPlane", py::overload_cast<int>(&msl::SoADM<Pixel>::getPlane))
+        .def("getPlane", py::overload_cast<const std::string&>(&msl::SoADM<Pixel>::getPlane))
+        .def("gatherPlane", &msl::SoADM<Pixel>::gatherPlane)
+        .def("gather", &msl::SoADM<Pixel>::gather)
+        .def("mapIndexInPlaceM", py::overload_cast<const std::function<Pixel(int,int,Pixel)>&>(&msl::SoADM<Pixel>::mapIndexInPlaceM))
+        .def("mapInPlaceKernel", &msl::SoADM<Pixel>::mapInPlaceKernel, py::arg("body"), py::arg("params") = std::vector<double>(),
+             py::call_guard<py::gil_scoped_release>())
+    ;
+}
@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <memory>
+#include "../include/muesli.h"
+#include "../include/threadpool.h"
+#include "../include/detail/topology.h"
+
+namespace {
+
+// true inside the tasks of a pool, where nested calls must not wait for the
+// (busy) workers
+thread_local bool insideTask = false;
+
+std::uint64_t pack(int begin, int end)
+{
+  return (std::uint64_t) begin << 32 | (std::uint32_t) end;
+}
+
+void unpack(std::uint64_t bounds, int& begin, int& end)
+{
+  begin = (int) (bounds >> 32);
+  end = (int) (bounds & 0xffffffffu);
+}
+
+std::unique_ptr<msl::ThreadPool>& pool()
+{
+  static std::unique_ptr<msl::ThreadPool> instance;
+  return instance;
+}
+
+std::vector<int>& pinnedCpus()
+{
+  static std::vector<int> cpus;
+  return cpus;
+}
+
+}
+
+msl::ThreadPool::ThreadPool(int numThreads, const std::vector<int>& cpus)
+    : cpus(cpus), task(nullptr), count(0), grain(1), parts(0), ranges(new Range[numThreads]),
+      remaining(0), failed(false), generation(0), pending(0), stop(false)
+{
+  for (int worker = 1; worker < numThreads; worker++) {
+    workers.emplace_back(&ThreadPool::work, this, worker);
+  }
+}
+
+msl::ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  wake.notify_all();
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+}
+
+int msl::ThreadPool::size() const
+{
+  return (int) workers.size() + 1;
+}
+
+void msl::ThreadPool::parallelFor(int count, int grain, const Task& task)
+{
+  grain = std::max(1, grain);
+  int parts = std::min(size(), std::max(1, count / grain));
+  if (parts <= 1 || insideTask) {
+    task(0, count);
+    return;
+  }
+
+  std::lock_guard<std::mutex> job(submit);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->task = &task;
+    this->count = count;
+    this->grain = grain;
+    this->parts = parts;
+    for (int part = 0; part < parts; part++) {
+      int begin = (int) ((long) count * part / parts);
+      int end = (int) ((long) count * (part + 1) / parts);
+      ranges[part].bounds.store(pack(begin, end));
+    }
+    remaining.store(count);
+    error = nullptr;
+    failed.store(false);
+    pending = parts - 1;
+    generation++;
+  }
+  wake.notify_all();
+
+  // the calling thread (e.g. the Python interpreter) keeps its own placement
+  // outside of the pool
+  std::vector<int> affinity;
+  if (!cpus.empty()) {
+    affinity = detail::threadAffinity();
+    detail::pinThread(cpus[0]);
+  }
+  runPart(0);
+  if (!affinity.empty()) {
+    detail::pinThread(affinity);
+  }
+
+  std::unique_lock<std::mutex> lock(mutex);
+  done.wait(lock, [this] { return pending == 0; });
+  this->task = nullptr;
+  if (error) {
+    std::exception_ptr e = error;
+    error = nullptr;
+    std::rethrow_exception(e);
+  }
+}
+
+void msl::ThreadPool::runPart(int part)
+{
+  int begin, end;
+  insideTask = true;
+  while (remaining.load() > 0) {
+    if (take(part, begin, end) || steal(part, begin, end)) {
+      // after a failure the remaining chunks are only counted down
+      if (!failed.load()) {
+        try {
+          (*task)(begin, end);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(mutex);
+          if (!error) {
+            error = std::current_exception();
+          }
+          failed.store(true);
+        }
+      }
+      remaining.fetch_sub(end - begin);
+    } else {
+      // the last chunks are being processed by other threads
+      std::this_thread::yield();
+    }
+  }
+  insideTask = false;
+}
+
+// takes the next chunk from the front of the own range
+bool msl::ThreadPool::take(int part, int& begin, int& end)
+{
+  std::uint64_t bounds = ranges[part].bounds.load();
+  for (;;) {
+    int b, e;
+    unpack(bounds, b, e);
+    if (b >= e) {
+      return false;
+    }
+    int c = std::min(grain, e - b);
+    if (ranges[part].bounds.compare_exchange_weak(bounds, pack(b + c, e))) {
+      begin = b;
+      end = b + c;
+      return true;
+    }
+  }
+}
+
+// moves the back half of the largest remaining range of another thread to
+// the own range and takes its first chunk
+bool msl::ThreadPool::steal(int part, int& begin, int& end)
+{
+  for (;;) {
+    int victim = -1;
+    int largest = 0;
+    std::uint64_t bounds = 0;
+    for (int p = 0; p < parts; p++) {
+      std::uint64_t current = ranges[p].bounds.load();
+      int b, e;
+      unpack(current, b, e);
+      if (p != part && e - b > largest) {
+        victim = p;
+        largest = e - b;
+        bounds = current;
+      }
+    }
+    // a single chunk is left to its owner
+    if (victim < 0 || largest <= grain) {
+      return false;
+    }
+    int b, e;
+    unpack(bounds, b, e);
+    int mid = b + (e - b) / 2;
+    if (ranges[victim].bounds.compare_exchange_strong(bounds, pack(b, mid))) {
+      int c = std::min(grain, e - mid);
+      ranges[part].bounds.store(pack(mid + c, e));
+      begin = mid;
+      end = mid + c;
+      return true;
+    }
+  }
+}
+
+void msl::ThreadPool::work(int worker)
+{
+  if (!cpus.empty()) {
+    detail::pinThread(cpus[worker % cpus.size()]);
+  }
+  long seen = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock, [this, seen] { return stop || generation != seen; });
+      if (stop) {
+        return;
+      }
+      seen = generation;
+      // workers without a part of this job wait for the next one
+      if (worker >= parts) {
+        continue;
+      }
+    }
+    runPart(worker);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      pending--;
+    }
+    done.notify_one();
+  }
+}
+
+msl::ThreadPool& msl::threadPool()
+{
+  int numThreads = std::max(1, getNumThreads());
+  if (!pool() || pool()->size() != numThreads) {
+    pool().reset();
+    pool().reset(new ThreadPool(numThreads, pinnedCpus()));
+  }
+  return *pool();
+}
+
+void msl::releaseThreadPool()
+{
+  pool().reset();
+}
+
+void msl::pinThreads(const std::vector<int>& cpus)
+{
+  pinnedCpus() = cpus;
+  // the pool is restarted with the new placement when it is used next
+  pool().reset();
+}
@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <pthread.h>
+#include <sched.h>
+#include "../include/detail/topology.h"
+
+namespace {
+
+// parses a CPU list such as "0-3,8-11"
+std::vector<int> parseCpuList(const std::string& list)
+{
+  std::vector<int> cpus;
+  std::istringstream in(list);
+  std::string item;
+  while (std::getline(in, item, ',')) {
+    if (item.empty() || item == "\n") {
+      continue;
+    }
+    size_t dash = item.find('-');
+    int first = std::stoi(item.substr(0, dash));
+    int last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+    for (int cpu = first; cpu <= last; cpu++) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+std::vector<std::vector<int>> readNodes()
+{
+  std::vector<std::vector<int>> nodes;
+  // node numbers may have gaps; stop after a run of missing ones
+  for (int node = 0, missing = 0; missing < 64; node++) {
+    std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string list;
+    if (!file || !std::getline(file, list)) {
+      missing++;
+      continue;
+    }
+    missing = 0;
+    std::vector<int> cpus = parseCpuList(list);
+    if (!cpus.empty()) {
+      nodes.push_back(cpus);
+    }
+  }
+  if (nodes.empty()) {
+    std::vector<int> all;
+    int count = std::max(1, (int) std::thread::hardware_concurrency());
+    for (int cpu = 0; cpu < count; cpu++) {
+      all.push_back(cpu);
+    }
+    nodes.push_back(all);
+  }
+  return nodes;
+}
+
+}
+
+std::vector<std::vector<int>> msl::detail::numaNodes()
+{
+  // the topology does not change while the program runs
+  static const std::vector<std::vector<int>> nodes = readNodes();
+  return nodes;
+}
+
+std::vector<int> msl::detail::nodeCpus()
+{
+  std::vector<int> cpus;
+  for (const std::vector<int>& node : numaNodes()) {
+    cpus.insert(cpus.end(), node.begin(), node.end());
+  }
+  return cpus;
+}
+
+std::vector<int> msl::detail::allowedCpus()
+{
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (pthread_getaffinity_np(pthread_self(), sizeof(allowed), &allowed) != 0) {
+    return nodeCpus();
+  }
+  std::vector<int> cpus;
+  for (int cpu : nodeCpus()) {
+    if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+bool msl::detail::pinThread(int cpu)
+{
+  if (cpu < 0 || cpu >= CPU_SETSIZE) {
+    return false;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+std::vector<int> msl::detail::threadAffinity()
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  std::vector<int> cpus;
+  if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &set)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+  return cpus;
+}
+
+bool msl::detail::pinThread(const std::vector<int>& cpus)
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &set);
+    }
+  }
+  if (CPU_COUNT(&set) == 0) {
+    return false;
+  }
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
@@ -1,3 +1,4 @@
+import ctypes
 import numpy as np
 from build.muesli import *
 
@@ -11,8 +12,15 @@ two = intDA(10, 2)
 
 array = np.array([0, 1, 2, 3, 4, 5, 6, 7, 8, 9])
 one.setArray(array)
+# only the root needs to hold the input; each process receives its partition
+scattered = intDA(10)
+scattered.scatterFrom(0, array if isRootProcess() else None)
+scattered.show()
 
 print("Element at Index 8: " + str(one.get(8)))
+# several elements in one collective exchange; each process may ask for others
+print("Elements at 9, 0, 4: " + str(one.getMany(np.array([9, 0, 4]))))
+print("Elements 2 to 5: " + str(one.getRange(2, 6)))
 
 two.set(2, 9)
 one.setLocal(3, 8)
@@ -44,6 +52,71 @@ two.show()
 three.show()
 four.show()
 
+
+def btest(a):
+    return a*10
+
+
+def bitest(i, a):
+    return i*a
+
+
+six = three.mapBatch(btest)
+four.mapIndexInPlaceBatch(bitest)
+six.show()
+four.show()
+
+seven = six.mapOp(Operator.AFFINE, 2, 1)
+seven.mapInPlaceOp("clamp", 0, 100)
+seven.show()
+
+# native functions (C symbols loaded with ctypes or numba.cfunc) are called
+# without the GIL; ctypes wrappers of Python functions are called through Python
+cabs = ctypes.CDLL(None).abs
+cabs.restype = ctypes.c_int
+cabs.argtypes = [ctypes.c_int]
+seven.mapInPlaceOp("sub", 50)
+seven.mapInPlace(cabs)
+seven.show()
+
+eight = one.mapExpr("x * 10 + i")
+eight.show()
+
+# with lazy evaluation, chained maps are fused into one pass over the data
+setLazyEvaluation(True)
+nine = eight.mapOp(Operator.ADD, 1).zip(three, lambda x, y: x - y)
+nine.mapInPlaceExpr("x * 2")
+nine.show()
+setLazyEvaluation(False)
+
+# f is called once per distinct value instead of once per element
+labels = two.mapUnique(lambda x: x * 100)
+labels.show()
+
+# the element type follows the dtype, no conversion to int or float
+big = DA(np.arange(10, dtype=np.int64) * 10**10)
+big.mapInPlaceOp(Operator.ADD, 1)
+big.show()
+waves = DA(np.exp(1j * np.linspace(0, np.pi, 10)))
+waves.mapInPlace(lambda z: z * z)
+waves.show()
+
+# the local partitions reside in a file; maps in place write through to it
+disk = floatDA(10, "testDA.bin")
+disk.fill(0.5)
+disk.mapInPlaceExpr("x + i")
+disk.flush()
+disk.show()
+
+# one-sided: each process updates elements of others without their participation
+hist = intDA(10, 0)
+barrier()
+for v in range(10):
+    hist.accumulate(v * v % 10, 1)
+barrier()
+print("Square residues: " + str(hist.remoteGet(1)) + " x 1, " + str(hist.remoteGet(4)) + " x 4")
+
+# only the root receives the array; the other processes get None
 five = one.gather()
 print(five)
 
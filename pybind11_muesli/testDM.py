@@ -25,6 +25,11 @@ if two.isLocal(9):
     print("This should only appear once")
 print("Local Element at Index 3: " + str(one.getLocal(3)))
 
+# NumPy view of the local partition (no copy); changes are visible in the DM
+local = two.getLocalPartition()
+local += 1
+two.show()
+
 
 def test(i):
     return i*10
@@ -44,7 +49,37 @@ two.show()
 three.show()
 four.show()
 
+
+def btest(a):
+    return a*10
+
+
+def b2test(row, col, a):
+    return row*10 + col + a
+
+
+six = three.mapBatch(btest)
+four.mapIndexInPlace2Batch(b2test)
+six.show()
+four.show()
+
+seven = six.mapOp(Operator.AFFINE, 2, 1)
+seven.mapInPlaceOp("clamp", 0, 100)
+seven.show()
+
+eight = one.mapExpr("row * 10 + col + x")
+eight.show()
+
+# double buffering: alternate between two matrices without allocating
+nine = one.mapOp(Operator.ADD, 0)
+for i in range(3):
+    eight.mapTo(test, nine)
+    nine.mapTo(test, eight)
+eight.show()
+
 five = one.gather()
 print(five)
+# only the elements in columns 1 to 3 are sent
+print(one.gatherRegion(0, 2, 1, 4))
 
 terminateSkeletons()